@@ -1,12 +1,40 @@
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
+#include <stdbool.h>
 
 static inline void hlt(void)
 {
     asm volatile ( "hlt" );
 }
 
+static inline void cli(void)
+{
+    asm volatile ( "cli" );
+}
+
+static inline void sti(void)
+{
+    asm volatile ( "sti" );
+}
+
+// Enables interrupts and halts until the next one
+// Interrupts are only enabled after the instruction following sti, so no interrupt can be missed in between
+static inline void sti_hlt(void)
+{
+    asm volatile ( "sti\n\thlt" );
+}
+
+// Returns true if maskable interrupts are enabled
+static inline bool interrupts_enabled(void)
+{
+    uint32_t flags = 0;
+    asm volatile ( "pushf\n\tpop %0"
+                : "=r"(flags) );
+    return flags & 0x200;
+}
+
 static inline uint8_t inb(uint16_t port)
 {
     uint8_t ret = 0;
@@ -54,3 +82,48 @@ static inline void outl(uint16_t port, uint32_t val)
                 :
                 : "a"(val), "Nd"(port) );
 }
+
+// Reads the CPU's time-stamp counter (number of cycles since reset)
+static inline uint64_t rdtsc(void)
+{
+    uint64_t ret = 0;
+    asm volatile ( "rdtsc"
+                : "=A"(ret) );
+    return ret;
+}
+
+// Copies count 4 byte words from src to dst
+static inline void rep_movsd(void* dst, const void* src, size_t count)
+{
+    asm volatile ( "rep movsl"
+                : "+D"(dst), "+S"(src), "+c"(count)
+                :
+                : "memory" );
+}
+
+// Fills count 4 byte words at dst with val
+static inline void rep_stosd(void* dst, uint32_t val, size_t count)
+{
+    asm volatile ( "rep stosl"
+                : "+D"(dst), "+c"(count)
+                : "a"(val)
+                : "memory" );
+}
+
+// Reads count 2 byte words from an I/O port to dst
+static inline void rep_insw(uint16_t port, void* dst, size_t count)
+{
+    asm volatile ( "rep insw"
+                : "+D"(dst), "+c"(count)
+                : "d"(port)
+                : "memory" );
+}
+
+// Writes count 2 byte words from src to an I/O port
+static inline void rep_outsw(uint16_t port, const void* src, size_t count)
+{
+    asm volatile ( "rep outsw"
+                : "+S"(src), "+c"(count)
+                : "d"(port)
+                : "memory" );
+}
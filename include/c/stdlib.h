@@ -2,6 +2,8 @@
 
 #include <stddef.h>
 
+#include <drivers/memory.h>
+
 #if defined(__cplusplus)
 extern "C"
 {
@@ -21,11 +23,12 @@ inline void operator delete(void* ptr)
 }
 
 // Stores an object in memory and returns a pointer to it
+// The object lives in the active memory region if there is one, it's released together with the region
 template<class T>
 inline void* memstore(const T value)
 {
     // Make space in memory for the object
-    T* ptr = (T*)malloc(sizeof(T));
+    T* ptr = (T*)mem_regionalloc(sizeof(T));
     // Copy the object to the allocated memory space
     (*ptr) = value;
     // Return pointer to the value stored in memory
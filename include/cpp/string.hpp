@@ -26,8 +26,12 @@ public:
     // ---- CAPACITY ----
 	// Returns the length of the string
     size_t size(void) const;
+	// Returns the number of characters the string can hold without resizing its memory segment
+	size_t capacity(void) const;
 	// Resizes the string and puts '\0' at the end of it
     void resize(const size_t newsize);
+	// Makes space for at least newcapacity characters, never shrinks the string
+	void reserve(const size_t newcapacity);
 	// Clears the string by resizing it to 0
     void clear(void);
 	// Returns true if the string is empty (if it's length is 0)
@@ -121,6 +125,7 @@ private:
     void* m_ptr;
     char* m_ptrC;
     size_t m_size;
+    size_t m_capacity; // excluding the terminating '\0'
 
 	// Updates m_ptr and m_ptrC
     void updatePtr(void* ptr);
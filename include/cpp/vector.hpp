@@ -4,6 +4,7 @@
 #include <stdint.h>
 
 #include <c/stdlib.h>
+#include <drivers/memory.h>
 #include <kernel.h>
 
 template<class T>
@@ -14,7 +15,8 @@ public:
         m_sizeofT(sizeof(T)),
         m_ptr(malloc(0)),
         m_ptrT((T*)m_ptr),
-        m_size(0) { }
+        m_size(0),
+        m_capacity(mem_dynsize(m_ptr) / sizeof(T)) { }
 
     inline void dispose(void)
     { delete m_ptrT; }
@@ -29,8 +31,28 @@ public:
     inline size_t size(void) const
     { return m_size; }
     //
+    inline size_t capacity(void) const
+    { return m_capacity; }
+    // Grows the capacity geometrically, so that appending elements one at a time is linear
     inline void resize(const size_t newsize)
-    { updatePtr(realloc(m_ptr, (m_size = newsize) * m_sizeofT)); }
+    {
+        if (newsize > m_capacity)
+        {
+            reserve(newsize > m_capacity * 2 ? newsize : m_capacity * 2);
+        }
+
+        m_size = newsize;
+    }
+    // Makes space for at least newcapacity elements, never shrinks the vector
+    inline void reserve(const size_t newcapacity)
+    {
+        if (newcapacity > m_capacity)
+        {
+            updatePtr(realloc(m_ptr, newcapacity * m_sizeofT));
+            // The memory segment may be able to hold more elements than requested
+            m_capacity = mem_dynsize(m_ptr) / m_sizeofT;
+        }
+    }
     //
     inline void clear(void)
     { resize(0); }
@@ -112,6 +134,8 @@ private:
     T* m_ptrT;
     // Amount of elements stored in the vector
     size_t m_size;
+    // Amount of elements the memory segment can hold
+    size_t m_capacity;
 
     inline void updatePtr(void* ptr)
     {
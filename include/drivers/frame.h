@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Physical memory is handed out in frames of FRAME_SIZE bytes
+#define FRAME_SIZE 0x1000
+
+// Returns the number of unused frames in a row beginning at ptr
+size_t frame_run(const void* const ptr);
+// Finds the longest run of unused frames, stores its length in count and returns its beginning
+void* frame_largest(size_t* const count);
+// Marks count frames beginning at ptr as used, returns false if any of them is already used
+bool frame_claim(const void* const ptr, const size_t count);
@@ -3,10 +3,56 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#if defined(__cplusplus)
+extern "C"
+{
+#endif
+
+// Allocator statistics, all the sizes are in bytes
+struct MEM_STATS
+{
+    size_t used;        // memory taken from the heap, including whole slab pages and buddy superblocks
+    size_t empty;       // memory that can still be taken from the heap
+    size_t peak;        // highest amount of used memory so far
+    size_t allocated;   // memory in live allocations, rounded up to the size of their slab object / buddy block / segment
+    size_t segments;    // number of live allocations
+    size_t largestfree; // longest run of unused memory
+};
+
 size_t mem_used(void);
 size_t mem_empty(void);
+// Fills stats with the current state of the allocator
+void mem_stats(struct MEM_STATS* const stats);
 void mem_free(const void* const ptr);
 void mem_copy(const void* const ptrsrc, const void* const ptrdst, const size_t length);
+void mem_move(const void* const ptrsrc, const void* const ptrdst, const size_t length);
 void* mem_dynalloc(const size_t initsize);
+// Same as mem_dynalloc(), except the allocation is attributed to caller by the allocation profiler
+void* mem_tracedalloc(const size_t initsize, const void* const caller);
+// Returns the number of bytes the dynamic segment can hold without being resized
+size_t mem_dynsize(const void* const ptr);
 void* mem_dynresize(void* const ptr, const size_t newsize);
+// Same as mem_dynresize(), except the resize is attributed to caller by the allocation profiler
+void* mem_tracedresize(void* const ptr, const size_t newsize, const void* const caller);
 void* mem_set(void* ptr, int value, size_t num);
+
+// Allocates memory beginning at a multiple of align bytes, align must be a power of two
+// The memory is freed using mem_free(), resizing it doesn't preserve the alignment
+void* mem_alignalloc(const size_t size, const size_t align);
+// Allocates a physically contiguous buffer usable for DMA transfers, freed using mem_free()
+// If boundary isn't 0, the buffer doesn't cross any multiple of boundary bytes,
+// unless it's bigger than the boundary, in which case it begins at such a multiple
+void* mem_dmaalloc(const size_t size, const size_t boundary);
+// Returns the physical address of a buffer, e.g. to pass it to a DMA controller
+size_t mem_physaddr(const void* const ptr);
+
+// Memory regions hold short-lived objects, which are all released at once when the region ends
+// Regions can be nested, objects are always allocated from the innermost one
+void mem_regionpush(void);
+void mem_regionpop(void);
+// Objects allocated this way may be passed to mem_free(), but they're only released by mem_regionpop()
+void* mem_regionalloc(const size_t size);
+
+#if defined(__cplusplus)
+}
+#endif
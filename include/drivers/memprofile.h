@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif
+
+// Allocations are grouped into size buckets by powers of two, bucket i holds sizes in [2^(i-1), 2^i)
+// Bucket 0 holds empty allocations
+#define MEMPROF_BUCKET_COUNT 0x21
+
+// Allocation statistics of a single call site
+struct MEMPROF_SITE
+{
+    const void* caller; // return address of the allocation call
+    size_t allocs;      // number of objects allocated by the call site
+    size_t frees;       // number of those objects that have been freed already
+    size_t resizes;     // number of resizes done by the call site
+    size_t livebytes;   // requested size of the objects that are still allocated
+    size_t totalbytes;  // requested size of all the objects allocated so far
+    uint64_t lifetime;  // sum of the lifetimes of the freed objects in CPU cycles
+};
+
+// Profiling only takes place in DEBUG mode, these are no-ops otherwise
+void memprof_alloc(const void* const ptr, const size_t size, const void* const caller);
+void memprof_resize(const void* const oldptr, const void* const newptr, const size_t newsize, const void* const caller);
+void memprof_free(const void* const ptr);
+
+// Returns true if allocations are being profiled
+bool memprof_enabled(void);
+// Copies up to count call sites with the most allocations to sites, returns the number of copied sites
+size_t memprof_top(struct MEMPROF_SITE* const sites, const size_t count);
+// Copies the number of allocations in each size bucket to buckets
+void memprof_histogram(size_t* const buckets);
+// Returns the number of live objects being tracked
+size_t memprof_live(void);
+// Returns the number of allocations that couldn't be tracked because the profiler was full
+size_t memprof_untracked(void);
+
+#if defined(__cplusplus)
+}
+#endif
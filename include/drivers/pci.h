@@ -3,6 +3,7 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <stdbool.h>
 
 struct pcidevice
 {
@@ -30,4 +31,17 @@ struct pcidevice
     uint32_t baseaddr5;
 };
 
+// PCI device classes
+#define PCI_CLASS_MASS_STORAGE 0x01
+#define PCI_SUBCLASS_IDE 0x01
+#define PCI_SUBCLASS_SATA 0x06
+
+// Reads / writes a 4 byte register from / to the configuration space of a device
+uint32_t pciConfigRead(const uint8_t bus, const uint8_t slot, const uint8_t func, const uint8_t offset);
+void pciConfigWrite(const uint8_t bus, const uint8_t slot, const uint8_t func, const uint8_t offset, const uint32_t value);
+
 struct pcidevice* getPciDevice(const uint8_t bus, const uint8_t slot, const uint8_t func);
+// Finds the first device of a specified class and subclass, returns false if there is no such device
+bool findPciDevice(const uint8_t classid, const uint8_t subclass, uint8_t* const busptr, uint8_t* const slotptr, uint8_t* const funcptr);
+// Allows a device to initiate DMA transfers
+void pciEnableBusMaster(const uint8_t bus, const uint8_t slot, const uint8_t func);
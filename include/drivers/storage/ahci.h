@@ -57,6 +57,12 @@ typedef struct tagFIS_DEV_BITS
 
 #define ATA_CMD_READ_DMA_EX 0x25
 #define ATA_CMD_WRITE_DMA_EX 0x35
+#define ATA_CMD_READ_FPDMA_QUEUED 0x60
+#define ATA_CMD_WRITE_FPDMA_QUEUED 0x61
+#define ATA_CMD_IDENTIFY 0xEC
+
+#define HBA_CAP_SNCQ (1<<30)
+#define HBA_GHC_AE (1U<<31)
 
 #define HBA_PxIS_TFES (1<<30)
 
@@ -417,6 +423,11 @@ typedef struct tagHBA_CMD_TBL
 	HBA_PRDT_ENTRY	prdt_entry[1];	// Physical region descriptor table entries, 0 ~ 65535
 } HBA_CMD_TBL;
 
+// Finds the AHCI controller on the PCI bus and adds the SATA drives attached to it
+void ahci_init(void);
 void probe_port(HBA_MEM *abar);
-//void port_rebase(HBA_PORT *port, int portno); // I don't really know what this is for
+// Gives the port its own command list, received FIS area and command tables
+void port_rebase(HBA_PORT *port);
+// Transfer count sectors between the drive and a word-aligned buffer, return FALSE on error
 BOOL ahci_read(HBA_PORT *port, QWORD start, DWORD count, WORD *buf);
+BOOL ahci_write(HBA_PORT *port, QWORD start, DWORD count, const WORD *buf);
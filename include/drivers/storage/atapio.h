@@ -7,6 +7,9 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+// Longest time a drive may take to respond before it's considered hung, in milliseconds
+#define ATA_TIMEOUT_MS 3000
+
 enum BUS
 {
     BUS_PRIMARY = 0x1F0,
@@ -19,11 +22,25 @@ enum DRIVE
     DRIVE_SLAVE = 0x1,
 };
 
+// Programs the drive's address and sector count registers before issuing an LBA48 command
+void setupLBA48(const enum BUS bus, const enum DRIVE drive, const uint64_t addr, const size_t count);
+// Waits until none of the status bits are set, returns false if the drive doesn't respond within ATA_TIMEOUT_MS
+bool awaitStatusFalse(const enum BUS bus, const uint8_t status);
+// Halts the CPU until the next interrupt, unless the drive on the bus has already raised one since the last call
+void ataWait(const enum BUS bus);
+// Resets both drives on the bus, used to abort a command the drive hasn't finished, returns false if they don't recover
+bool resetBus(const enum BUS bus);
+
 bool probeBus(const enum BUS bus);
 bool probeDrive(const enum BUS bus, const enum DRIVE drive);
 
 uint8_t* readLBA28(const enum BUS bus, const enum DRIVE drive, const uint32_t addr);
 uint8_t* readLBA48(const enum BUS bus, const enum DRIVE drive, const uint64_t addr);
+// Reads count sectors into a buffer provided by the caller, returns false on error
+// Uses as few commands as possible, READ MULTIPLE is used if the drive supports it
+bool readLBA48Into(const enum BUS bus, const enum DRIVE drive, const uint64_t addr, const size_t count, uint8_t* const buffer);
 
 void writeLBA28(const enum BUS bus, const enum DRIVE drive, const uint32_t addr, const uint8_t* const buffer);
 void writeLBA48(const enum BUS bus, const enum DRIVE drive, const uint64_t addr, const uint8_t* const buffer);
+// Writes count sectors from a buffer, returns false on error
+bool writeLBA48From(const enum BUS bus, const enum DRIVE drive, const uint64_t addr, const size_t count, const uint8_t* const buffer);
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif
+
+// Number of sectors held by the block cache
+#define CACHE_BLOCKS 0x400
+// Transfers of at least this many sectors bypass the cache, so that large files don't evict everything else
+#define CACHE_BYPASS_SECTORS 0x40
+
+// Statistics of the block cache since boot
+struct CACHE_STATS
+{
+    size_t hits;       // sectors found in the cache
+    size_t misses;     // sectors that had to be read from the disk
+    size_t writebacks; // dirty sectors written to the disk
+    size_t dirty;      // sectors that are currently waiting to be written to the disk
+};
+
+// Read count sectors through the cache, return false on failure
+bool cache_read(const uint8_t hddIdx, const uint64_t lba, const size_t count, uint8_t* const buffer);
+// Writes count sectors through the cache, small writes are only written to the disk once the sectors are evicted or flushed
+bool cache_write(const uint8_t hddIdx, const uint64_t lba, const size_t count, const uint8_t* const buffer);
+// Writes all dirty sectors to the disk, returns false if any of them couldn't be written
+bool cache_flush(void);
+void cache_stats(struct CACHE_STATS* const stats);
+
+#if defined(__cplusplus)
+}
+#endif
@@ -58,7 +58,8 @@ struct VOLUMEID
     uint32_t fatSectors;        // 0x024
     uint8_t unknown2[0x4];      // 0x028
     uint32_t rootDirCluster;    // 0x02C
-    uint8_t unknown3[0x12];     // 0x030
+    uint16_t fsInfoSector;      // 0x030
+    uint8_t unknown3[0x10];     // 0x032
     uint8_t extBootSignature;   // 0x042
     uint32_t volumeID;          // 0x043
     char label[0xB];            // 0x047
@@ -67,9 +68,47 @@ struct VOLUMEID
     uint16_t signature;         // 0x1FE
 } __attribute__((packed));
 
+// FAT32 FSInfo sector, holds the number of free clusters and a hint where to look for the next free cluster
+//  -- 0x000 [0x004] : Lead signature (0x41615252)
+//  -- 0x1E4 [0x004] : Structure signature (0x61417272)
+//  -- 0x1E8 [0x004] : Free cluster count (0xFFFFFFFF if unknown)
+//  -- 0x1EC [0x004] : Next free cluster hint (0xFFFFFFFF if unknown)
+//  -- 0x1FE [0x002] : Boot sector signature (0x55, 0xAA)
+static const uint32_t FSINFO_LEAD_SIGNATURE = 0x41615252;
+static const uint32_t FSINFO_STRUCT_SIGNATURE = 0x61417272;
+
+struct FSINFO
+{
+    uint32_t leadSignature;     // 0x000
+    uint8_t unknown1[0x1E0];    // 0x004
+    uint32_t structSignature;   // 0x1E4
+    uint32_t freeClusters;      // 0x1E8
+    uint32_t nextFree;          // 0x1EC
+    uint8_t unknown2[0xE];      // 0x1F0
+    uint16_t signature;         // 0x1FE
+} __attribute__((packed));
+
 void hdd_init_last(void);
 
 // ---- PARTITION ----
+// A run of consecutive clusters in a cluster chain
+struct CLUSTER_EXTENT
+{
+    uint32_t start;
+    uint32_t length; // an extent of length 0 terminates an array of extents
+};
+
+// Number of cluster chains cached for each partition
+#define CHAIN_CACHE_SIZE 0x10
+
+struct CHAIN_CACHE_ENTRY
+{
+    uint32_t firstClust;
+    uint32_t generation;            // FAT generation the extents were built from
+    uint32_t lastUse;               // used to find the least recently used entry
+    struct CLUSTER_EXTENT* extents; // nullptr if the entry is empty
+};
+
 struct PARTITION
 {
     char oemname[0x8];
@@ -77,6 +116,7 @@ struct PARTITION
     uint16_t reservedSectors;
     uint32_t fatSectors;
     uint32_t rootDirCluster;
+    uint16_t fsInfoSector;
     uint8_t extBootSignature;
     uint32_t volumeID;
     char label[0xB];
@@ -85,6 +125,26 @@ struct PARTITION
     uint8_t hddIdx;
     uint32_t lbaBegin;
     uint32_t sectorCount;
+
+    // Copy of the first FAT loaded at mount, all chain walks and allocations use it instead of the disk
+    uint32_t* fat;
+    // Bitmap of the FAT sectors modified since they were last written to the disk
+    uint32_t* fatDirty;
+
+    // Number of valid cluster indices, clusters 0 and 1 are reserved and never allocated
+    uint32_t clusterCount;
+    // Bitmap of the free clusters, built at mount and kept up to date by fatWrite()
+    uint32_t* freeMap;
+    uint32_t freeClusters;
+    // Cluster where the search for a free cluster begins, the cluster after the last allocated one
+    uint32_t nextFree;
+    // The free cluster count and the hint have changed and the FSInfo sector has to be updated
+    bool fsInfoDirty;
+
+    // Recently used cluster chains stored as extents, any change of the FAT increments its generation and makes them stale
+    struct CHAIN_CACHE_ENTRY chainCache[CHAIN_CACHE_SIZE];
+    uint32_t fatGeneration;
+    uint32_t chainCacheClock;
 };
 
 extern struct PARTITION partArray[0x10];
@@ -124,6 +184,18 @@ struct DIR_SECTOR
     struct DIR_ENTRY entries[16];
 } __attribute__((packed));
 
+// Compares two FAT file names ("NAME    EXT") as two 32 bit words, a 16 bit word and a byte
+static inline bool fileNameEqual(const char* const fileName1, const char* const fileName2)
+{
+    typedef uint32_t __attribute__((may_alias)) name_dword_t;
+    typedef uint16_t __attribute__((may_alias)) name_word_t;
+
+    return ((const name_dword_t*)fileName1)[0] == ((const name_dword_t*)fileName2)[0] &&
+        ((const name_dword_t*)fileName1)[1] == ((const name_dword_t*)fileName2)[1] &&
+        *(const name_word_t*)&fileName1[8] == *(const name_word_t*)&fileName2[8] &&
+        fileName1[10] == fileName2[10];
+}
+
 static const uint8_t FILE_ATTRIB_READ_ONLY  = 0x01;
 static const uint8_t FILE_ATTRIB_HIDDEN     = 0x02;
 static const uint8_t FILE_ATTRIB_SYSTEM     = 0x04;
@@ -151,10 +223,20 @@ extern "C"
 uint64_t clusterToSector(const uint8_t partIdx, const uint32_t clust);
 // Returns an array of clusters chained after a specified cluster
 uint32_t* getClusterChain(const uint8_t partIdx, const uint32_t firstClust);
-// Finds a first empty cluster on a specified partition
+// Returns a cluster chain as an array of extents terminated by an extent of length 0, the array must be freed by the caller
+// Consecutive clusters occupy consecutive sectors, so each extent can be transferred by a single command
+struct CLUSTER_EXTENT* getClusterExtents(const uint8_t partIdx, const uint32_t firstClust);
+// Finds the next empty cluster on a specified partition, starting at the cluster after the last allocated one
 uint32_t findEmptyCluster(const uint8_t partIdx);
-// Writes an entry to the FAT table
+// Loads the FAT of a partition into memory and builds its free cluster bitmap, returns false if it can't be read
+bool fatLoad(const uint8_t partIdx);
+// Writes an entry to the FAT table, the change only reaches the disk once the FAT is flushed
 void fatWrite(const uint8_t partIdx, const uint32_t clustIdx, const uint32_t content);
+// Writes the modified FAT sectors to all copies of the FAT on the disk and updates the FSInfo sector
+bool fatFlush(const uint8_t partIdx);
+// Allocates clusters, preferably in runs of consecutive clusters, and links them after lastClust
+// If lastClust is 0, a new cluster chain is created, returns the first allocated cluster or 0 on failure
+uint32_t allocateClusterChain(const uint8_t partIdx, const uint32_t lastClust, const size_t clustCount);
 // Adds a specified amount of empty clusters to the end of a cluster chain
 bool prolongClusterChain(const uint8_t partIdx, const uint32_t firstClust, const size_t clustCount);
 // Removes a specified amount of sectors from the end of a cluster chain
@@ -162,7 +244,8 @@ bool shortenClusterChain(const uint8_t partIdx, const uint32_t firstClust, const
 // Convert a FAT file name to a standard cstring format ("NAME    EXT" to "name.ext")
 char* fileNameToString(const char* const fileName);
 // Converts a cstring file name to a FAT file name ("name.ext" to "NAME    EXT")
-void stringToFileName(const char* const strSrc, char* const fileNameDst);
+// Returns false if the name doesn't fit the 8.3 format, in which case no entry can have the name
+bool stringToFileName(const char* const strSrc, char* const fileNameDst);
 // Version of the stringToFileName() function which ignores dots and therefore doesn't handle extensions
 void stringToFileNameNoExt(const char* const strSrc, char* const fileNameDst);
 // Checks directory entry attributes using mask
@@ -182,6 +265,18 @@ bool extractPath(const uint8_t partIdx, const uint32_t baseDir, const char* cons
 // Calculates how many clusters are required to store a specified amount of bytes
 size_t bytesToClusterCount(const uint8_t partIdx, const uint32_t sizeInBytes);
 
+// ---- DIRECTORY ENTRY CACHE ----
+// Names are in the FAT format ("NAME    EXT")
+// Looks up a name in the cache of directory entries, returns false if the name isn't cached
+// Otherwise found tells whether the directory contains the name and entry receives a copy of its directory entry
+bool dcacheLookup(const uint8_t partIdx, const uint32_t dirCluster, const char* const fileName, bool* const found, struct DIR_ENTRY* const entry);
+// Remembers the result of a directory search, entry is nullptr if the directory doesn't contain the name
+void dcacheInsert(const uint8_t partIdx, const uint32_t dirCluster, const char* const fileName, const struct DIR_ENTRY* const entry);
+// Forgets a name in a directory, must be called whenever the directory entry is created, modified or deleted
+void dcacheInvalidate(const uint8_t partIdx, const uint32_t dirCluster, const char* const fileName);
+// Forgets all names in a directory, used when its cluster is freed or reused
+void dcacheInvalidateDir(const uint8_t partIdx, const uint32_t dirCluster);
+
 // ---- ENTRY ----
 struct DIR_ENTRY* findEntry(const uint8_t partIdx, const uint32_t baseDirCluster, const char* const name, const uint8_t attribMask, const uint8_t attrib);
 struct FILE* getFile(const uint8_t partIdx, const uint32_t baseDir, const char* const path);
@@ -2,6 +2,7 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include <drivers/storage/ahci.h>
 
 #define HDD_TYPE_UNKNOWN 0
@@ -21,11 +22,29 @@ extern uint8_t hddCount;
 
 #if defined(__cplusplus)
 extern "C"
+{
 #endif
+
 char* getHddInfoStr(const uint8_t hddIdx);
 
 void hddAddIDE(const uint16_t bus, const uint8_t drive);
 void hddAddAHCI(const HBA_PORT* const port);
 
+// Reads a sector into a newly allocated buffer, returns nullptr on failure
 uint8_t* hddRead(const uint8_t hddIdx, const uint64_t lba);
 void hddWrite(const uint8_t hddIdx, const uint64_t lba, const uint8_t* const data);
+
+// Reads count sectors into a buffer provided by the caller, returns false on failure
+// The buffer must be at least count * 512 bytes long and word-aligned
+bool hddReadInto(const uint8_t hddIdx, const uint64_t lba, const size_t count, uint8_t* const buffer);
+// Writes count sectors from a buffer provided by the caller, returns false on failure
+// Small writes stay in the block cache until it's flushed
+bool hddWriteFrom(const uint8_t hddIdx, const uint64_t lba, const size_t count, const uint8_t* const buffer);
+
+// Same as hddReadInto() and hddWriteFrom(), but bypass the block cache
+bool hddReadDirect(const uint8_t hddIdx, const uint64_t lba, const size_t count, uint8_t* const buffer);
+bool hddWriteDirect(const uint8_t hddIdx, const uint64_t lba, const size_t count, const uint8_t* const buffer);
+
+#if defined(__cplusplus)
+}
+#endif
@@ -0,0 +1,18 @@
+#pragma once
+// http://wiki.osdev.org/ATA/ATAPI_using_DMA
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <drivers/storage/atapio.h>
+
+// Finds a bus-master capable IDE controller on the PCI bus and prepares it for DMA transfers
+void idedma_init(void);
+// Returns true if DMA transfers can be used on a specified bus, which stops being the case once a transfer fails
+bool idedma_available(const enum BUS bus);
+
+// Transfer count sectors between the drive and a buffer using DMA, return false on failure
+// The buffer must be physically contiguous and word-aligned
+bool idedma_read(const enum BUS bus, const enum DRIVE drive, const uint64_t addr, const size_t count, uint8_t* const buffer);
+bool idedma_write(const enum BUS bus, const enum DRIVE drive, const uint64_t addr, const size_t count, const uint8_t* const buffer);
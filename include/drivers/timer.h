@@ -0,0 +1,14 @@
+#pragma once
+// http://wiki.osdev.org/Programmable_Interval_Timer
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Frequency of the timer interrupt in Hz
+#define TIMER_FREQUENCY 1000
+
+// Programs the PIT to fire IRQ0 TIMER_FREQUENCY times per second
+void timer_init(void);
+// Returns the number of milliseconds since the timer has been initialized
+// Also works while interrupts are disabled, as long as it's called at least once every millisecond
+uint64_t timer_ms(void);
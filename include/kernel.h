@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stdint.h>
+
 #if defined(__cplusplus)
 extern "C"
 {
@@ -10,6 +12,8 @@ void kernel_panic(const char* const str);
 void debug_memusage(void);
 void debug_print(const char* const str);
 void debug_pause(void);
+// Prints how many CPU cycles something took
+void debug_cycles(const char* const str, const uint64_t cycles);
 
 #if defined(__cplusplus)
 }
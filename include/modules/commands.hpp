@@ -13,6 +13,8 @@ void cmd_move(const string& strArgs);
 void cmd_rename(const string& strArgs);
 void cmd_disk(const string& strArgs);
 void cmd_color(const string& strArgs);
+void cmd_bench(const string& strArgs);
+void cmd_meminfo(const string& strArgs);
 
 void cmd_text(const string& strArgs);
 void cmd_exec(const string& strArgs);
@@ -96,7 +96,7 @@ private:
     LOGICAL* varGetLogicalPtr(const string& varName); // returns a logical value pointer
     REAL* varGetRealPtr(const string& varName); // returns a real value pointer
     enum PROGRAM_NAME nameValid(const string& name); // checks if a name is valid (contains only valid characters and isn't a keyword)
-    void* valueCopy(const DataType type, const void* const source); // stores a value of specified data type in persistent memory space
+    void* valueCopy(const DataType type, const void* const source); // stores a copy of a value of specified data type in the active memory region
     INTEGER toInteger(const void* const value, const DataType type); // converts a value to integer
     LOGICAL toLogical(const void* const value, const DataType type); // converts a value to logical
     REAL toReal(const void* const value, const DataType type); // converts a value to real value
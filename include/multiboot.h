@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Multiboot information structure passed to the kernel by the bootloader (in EBX)
+//  -- 0x00 [0x04] : Flags (which of the following fields are valid)
+//  -- 0x04 [0x08] : Lower and upper memory size in KiB (flags bit 0)
+//  -- 0x2C [0x08] : Memory map length and address (flags bit 6)
+
+// Value of EAX when the kernel is loaded by a Multiboot compliant bootloader
+static const uint32_t MULTIBOOT_BOOTLOADER_MAGIC = 0x2BADB002;
+
+static const uint32_t MULTIBOOT_INFO_MEMORY = 0x01;
+static const uint32_t MULTIBOOT_INFO_MEM_MAP = 0x40;
+
+// Memory map entry type of RAM that is available to the operating system
+static const uint32_t MULTIBOOT_MEMORY_AVAILABLE = 0x1;
+
+struct MULTIBOOT_INFO
+{
+    uint32_t flags;             // 0x00
+    uint32_t memLower;          // 0x04
+    uint32_t memUpper;          // 0x08
+    uint32_t bootDevice;        // 0x0C
+    uint32_t cmdline;           // 0x10
+    uint32_t modsCount;         // 0x14
+    uint32_t modsAddr;          // 0x18
+    uint32_t syms[4];           // 0x1C
+    uint32_t mmapLength;        // 0x2C
+    uint32_t mmapAddr;          // 0x30
+} __attribute__((packed));
+
+// The size field isn't included in its own value, entries may be longer than this structure
+struct MULTIBOOT_MMAP_ENTRY
+{
+    uint32_t size;              // 0x00
+    uint64_t addr;              // 0x04
+    uint64_t len;               // 0x0C
+    uint32_t type;              // 0x14
+} __attribute__((packed));
@@ -7,23 +7,19 @@ void free(const void* const ptr)
 
 void* malloc(const size_t size)
 {
-    return mem_dynalloc(size);
+    // Attribute the allocation to the caller of malloc() rather than to malloc() itself
+    return mem_tracedalloc(size, __builtin_return_address(0));
 }
 
 void* calloc(const size_t size)
 {
-    void* ptr = malloc(size);
-    uint8_t* byteptr = (uint8_t*)ptr;
-
-    for (size_t i = 0; i < size; i++)
-    {
-        byteptr[i] = 0;
-    }
+    void* ptr = mem_tracedalloc(size, __builtin_return_address(0));
+    mem_set(ptr, 0, size);
 
     return ptr;
 }
 
 void* realloc(void* const ptr, size_t size)
 {
-    return mem_dynresize(ptr, size);
+    return mem_tracedresize(ptr, size, __builtin_return_address(0));
 }
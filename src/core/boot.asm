@@ -3,14 +3,16 @@ section .text
 ;grub bootloader header
         align 4
         dd 0x1BADB002            ;magic
-        dd 0x00                  ;flags
-        dd - (0x1BADB002 + 0x00) ;checksum. m+f+c should be zero
+        dd 0x02                  ;flags (bit 1 = provide memory information)
+        dd - (0x1BADB002 + 0x02) ;checksum. m+f+c should be zero
 
 global start
 extern kernel_main
 
 start:
   mov esp, stack_space  ;set stack pointer
+  push ebx              ;Multiboot information structure
+  push eax              ;Multiboot magic value
   call kernel_main
 
 ; We shouldn't get to here, but just in case do an infinite loop
@@ -1,9 +1,17 @@
 section .text
 
 global keyboard_handler_int
+global timer_handler_int
+global ata_primary_handler_int
+global ata_secondary_handler_int
+global spurious_handler_int
 global load_idt
 global load_gdt
 extern keyboard_handler
+extern timer_handler
+extern ata_primary_handler
+extern ata_secondary_handler
+extern spurious_handler
 
 ; GDT with a NULL Descriptor, a 32-Bit code Descriptor
 ; and a 32-bit Data Descriptor
@@ -57,6 +65,34 @@ keyboard_handler_int:
     popad
     iretd
 
+timer_handler_int:
+    pushad
+    cld
+    call timer_handler
+    popad
+    iretd
+
+ata_primary_handler_int:
+    pushad
+    cld
+    call ata_primary_handler
+    popad
+    iretd
+
+ata_secondary_handler_int:
+    pushad
+    cld
+    call ata_secondary_handler
+    popad
+    iretd
+
+spurious_handler_int:
+    pushad
+    cld
+    call spurious_handler
+    popad
+    iretd
+
 load_idt:
     mov edx, [esp + 4]
     lidt [edx]
@@ -7,16 +7,22 @@
 #include <c/math.h>
 
 #include <kernel.h>
+#include <drivers/memory.h>
 
 string::string(void) :
     m_ptr(malloc(1)),
     m_ptrC((char*)m_ptr),
-    m_size(0)
+    m_size(0),
+    m_capacity(mem_dynsize(m_ptr) - 1)
 {
     fixend();
 }
 
-string::string(const char* const str)
+string::string(const char* const str) :
+    m_ptr(malloc(strlen(str) + 1)),
+    m_ptrC((char*)m_ptr),
+    m_size(0),
+    m_capacity(mem_dynsize(m_ptr) - 1)
 {
     size_t strlength = strlen(str);
     
@@ -61,12 +67,33 @@ size_t string::size(void) const
     return m_size;
 }
 //
+size_t string::capacity(void) const
+{
+    return m_capacity;
+}
+//
 void string::resize(const size_t newsize)
 {
-    updatePtr(realloc(m_ptr, (m_size = newsize) + 1));
+    // Grow the capacity geometrically, so that appending characters one at a time is linear
+    if (newsize > m_capacity)
+    {
+        string::reserve(newsize > m_capacity * 2 ? newsize : m_capacity * 2);
+    }
+
+    m_size = newsize;
     fixend();
 }
 //
+void string::reserve(const size_t newcapacity)
+{
+    if (newcapacity > m_capacity)
+    {
+        updatePtr(realloc(m_ptr, newcapacity + 1));
+        // The memory segment may be able to hold more characters than requested
+        m_capacity = mem_dynsize(m_ptr) - 1;
+    }
+}
+//
 void string::clear(void)
 {
     string::resize(0);
@@ -0,0 +1,179 @@
+#include <drivers/frame.h>
+#include <drivers/memory.h>
+#include <drivers/io/terminal.h>
+#include <multiboot.h>
+#include <kernel.h>
+
+// Frames cover the whole 32-bit physical address space
+#define FRAME_COUNT 0x100000
+#define FRAME_USED_BLOCKS_PER_ELEMENT 0x20
+#define FRAME_USED_SIZE (FRAME_COUNT / FRAME_USED_BLOCKS_PER_ELEMENT)
+
+// Memory below 1 MiB is left to the BIOS and the VGA buffer
+#define FRAME_LOW_MEMORY_END 0x100000
+// Used when the bootloader doesn't tell us anything about the memory
+#define FRAME_FALLBACK_MEMORY_END 0x1000000
+
+// Defined by the linker script, the kernel image ends right before it
+extern uint8_t kernel_end[];
+
+// Each bit represents a single frame, 1 means the frame is used or doesn't exist at all
+static uint32_t frameused[FRAME_USED_SIZE];
+static size_t framefree = 0;
+
+// Marks count frames beginning at frame as used / unused
+void _frameset(size_t frame, size_t count, const bool isused)
+{
+    for (; count > 0 && frame < FRAME_COUNT; frame++, count--)
+    {
+        uint32_t mask = ((uint32_t)1) << (frame % FRAME_USED_BLOCKS_PER_ELEMENT);
+        bool wasused = frameused[frame / FRAME_USED_BLOCKS_PER_ELEMENT] & mask;
+
+        if (isused && !wasused)
+        {
+            frameused[frame / FRAME_USED_BLOCKS_PER_ELEMENT] |= mask;
+            framefree--;
+        }
+        else if (!isused && wasused)
+        {
+            frameused[frame / FRAME_USED_BLOCKS_PER_ELEMENT] &= ~mask;
+            framefree++;
+        }
+    }
+}
+
+// Returns true if the frame is used or doesn't exist
+static inline bool _frameused(const size_t frame)
+{
+    return frameused[frame / FRAME_USED_BLOCKS_PER_ELEMENT] & (((uint32_t)1) << (frame % FRAME_USED_BLOCKS_PER_ELEMENT));
+}
+
+// Marks the frames overlapping with a region of physical memory as used / unused
+// Only the frames that are entirely within the region are marked as unused
+void _frameregion(const uint64_t addr, const uint64_t len, const bool isused)
+{
+    // Memory above 4 GiB can't be accessed without paging
+    if (addr >= ((uint64_t)FRAME_COUNT) * FRAME_SIZE)
+        return;
+
+    uint64_t end = addr + len;
+
+    if (end > ((uint64_t)FRAME_COUNT) * FRAME_SIZE)
+        end = ((uint64_t)FRAME_COUNT) * FRAME_SIZE;
+
+    size_t first = (size_t)(isused ? addr / FRAME_SIZE : (addr + FRAME_SIZE - 1) / FRAME_SIZE);
+    size_t last = (size_t)(isused ? (end + FRAME_SIZE - 1) / FRAME_SIZE : end / FRAME_SIZE);
+
+    if (last > first)
+    {
+        _frameset(first, last - first, isused);
+    }
+}
+
+void frame_init(const uint32_t mbmagic, const struct MULTIBOOT_INFO* const mbinfo)
+{
+    // Every frame is unusable until the bootloader says otherwise
+    mem_set(frameused, 0xFF, sizeof(frameused));
+    framefree = 0;
+
+    if (mbmagic == MULTIBOOT_BOOTLOADER_MAGIC && (mbinfo->flags & MULTIBOOT_INFO_MEM_MAP))
+    {
+        size_t mmapend = mbinfo->mmapAddr + mbinfo->mmapLength;
+
+        // Make the available regions usable first
+        for (size_t entry = mbinfo->mmapAddr; entry < mmapend; entry += ((struct MULTIBOOT_MMAP_ENTRY*)entry)->size + sizeof(uint32_t))
+        {
+            struct MULTIBOOT_MMAP_ENTRY* region = (struct MULTIBOOT_MMAP_ENTRY*)entry;
+
+            if (region->type == MULTIBOOT_MEMORY_AVAILABLE)
+            {
+                _frameregion(region->addr, region->len, false);
+            }
+        }
+
+        // Reserved regions win if they overlap with available ones
+        for (size_t entry = mbinfo->mmapAddr; entry < mmapend; entry += ((struct MULTIBOOT_MMAP_ENTRY*)entry)->size + sizeof(uint32_t))
+        {
+            struct MULTIBOOT_MMAP_ENTRY* region = (struct MULTIBOOT_MMAP_ENTRY*)entry;
+
+            if (region->type != MULTIBOOT_MEMORY_AVAILABLE)
+            {
+                _frameregion(region->addr, region->len, true);
+            }
+        }
+    }
+    else if (mbmagic == MULTIBOOT_BOOTLOADER_MAGIC && (mbinfo->flags & MULTIBOOT_INFO_MEMORY))
+    {
+        // Upper memory begins at 1 MiB and its size is in KiB
+        _frameregion(FRAME_LOW_MEMORY_END, ((uint64_t)mbinfo->memUpper) << 10, false);
+    }
+    else
+    {
+        debug_print("frame.c | frame_init() | Bootloader didn't provide a memory map, assuming 16 MiB of memory!");
+        _frameregion(FRAME_LOW_MEMORY_END, FRAME_FALLBACK_MEMORY_END - FRAME_LOW_MEMORY_END, false);
+    }
+
+    // The low memory and the kernel itself must never be handed out
+    _frameregion(0, (size_t)kernel_end, true);
+
+    term_write("Usable memory: ", false);
+    term_write_convert(framefree / (0x100000 / FRAME_SIZE), 10);
+    term_writeline(" MiB", false);
+}
+
+size_t frame_run(const void* const ptr)
+{
+    size_t frame = (size_t)ptr / FRAME_SIZE;
+    size_t count = 0;
+
+    while (frame + count < FRAME_COUNT && !_frameused(frame + count))
+        count++;
+
+    return count;
+}
+
+void* frame_largest(size_t* const count)
+{
+    size_t bestbegin = 0;
+    size_t bestcount = 0;
+
+    for (size_t frame = 0; frame < FRAME_COUNT; )
+    {
+        // Skip whole elements of used frames at once
+        if (!(frame % FRAME_USED_BLOCKS_PER_ELEMENT) && frameused[frame / FRAME_USED_BLOCKS_PER_ELEMENT] == ~((uint32_t)0))
+        {
+            frame += FRAME_USED_BLOCKS_PER_ELEMENT;
+            continue;
+        }
+
+        if (_frameused(frame))
+        {
+            frame++;
+            continue;
+        }
+
+        size_t run = frame_run((void*)(frame * FRAME_SIZE));
+
+        if (run > bestcount)
+        {
+            bestbegin = frame;
+            bestcount = run;
+        }
+
+        frame += run;
+    }
+
+    *count = bestcount;
+    return (void*)(bestbegin * FRAME_SIZE);
+}
+
+bool frame_claim(const void* const ptr, const size_t count)
+{
+    if (frame_run(ptr) < count)
+    {
+        return false;
+    }
+
+    _frameset((size_t)ptr / FRAME_SIZE, count, true);
+    return true;
+}
@@ -1,13 +1,20 @@
 #include <assembly.h>
 #include <drivers/io/terminal.h>
+#include <drivers/timer.h>
 
 #define IDT_SIZE 256
 #define PIC_1_CTRL 0x20
 #define PIC_2_CTRL 0xA0
 #define PIC_1_DATA 0x21
 #define PIC_2_DATA 0xA1
+// OCW3 that makes the next read from the control port return the in-service register
+#define PIC_READ_ISR 0x0B
 
 extern void keyboard_handler_int(void);
+extern void timer_handler_int(void);
+extern void ata_primary_handler_int(void);
+extern void ata_secondary_handler_int(void);
+extern void spurious_handler_int(void);
 extern void load_idt(void*);
 
 struct idt_entry
@@ -58,8 +65,9 @@ static void initialize_pic()
     outb(PIC_2_DATA, 0x28);
 
     /* ICW3 - setup cascading */
-    outb(PIC_1_DATA, 0x00);
-    outb(PIC_2_DATA, 0x00);
+    /* The slave PIC is connected to IRQ2 of the master PIC, the master gets a bit mask, the slave gets the IRQ number */
+    outb(PIC_1_DATA, 0x04);
+    outb(PIC_2_DATA, 0x02);
 
     /* ICW4 - environment info */
     outb(PIC_1_DATA, 0x01);
@@ -71,6 +79,18 @@ static void initialize_pic()
     outb(0xA1 , 0xFF);
 }
 
+// The master PIC raises IRQ7 when an interrupt disappears before it's acknowledged
+// Such an interrupt isn't in service, so it mustn't get an EOI, only a real IRQ7 would have its ISR bit set
+void spurious_handler(void)
+{
+    outb(PIC_1_CTRL, PIC_READ_ISR);
+
+    if (inb(PIC_1_CTRL) & 0x80)
+    {
+        outb(PIC_1_CTRL, 0x20);
+    }
+}
+
 void idt_init(void)
 {
     initialize_pic();
@@ -81,10 +101,18 @@ void idt_init(void)
 void interrupts_init(void)
 {
     idt_init();
+    load_idt_entry(0x20, (unsigned long) timer_handler_int, 0x08, 0x8E);
     load_idt_entry(0x21, (unsigned long) keyboard_handler_int, 0x08, 0x8E);
-    
-    /* 0xFD is 11111101 - enables only IRQ1 (keyboard)*/
-    outb(0x21 , 0xFD);
+    load_idt_entry(0x27, (unsigned long) spurious_handler_int, 0x08, 0x8E);
+    load_idt_entry(0x2E, (unsigned long) ata_primary_handler_int, 0x08, 0x8E);
+    load_idt_entry(0x2F, (unsigned long) ata_secondary_handler_int, 0x08, 0x8E);
+
+    timer_init();
+
+    /* 0xF8 is 11111000 - enables IRQ0 (timer), IRQ1 (keyboard) and IRQ2 (slave PIC) */
+    outb(0x21 , 0xF8);
+    /* 0x3F is 00111111 - enables IRQ14 and IRQ15 (primary and secondary IDE) */
+    outb(0xA1 , 0x3F);
 
     term_writeline("Interrupts initialized.", false);
 }
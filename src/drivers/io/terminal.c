@@ -70,15 +70,7 @@ void term_newline(void)
 		activeRow = VGA_HEIGHT - 1;
 
 		// scroll rows up
-		size_t index = 0;		
-		for (size_t y = 0; y < VGA_HEIGHT - 1; y++)
-		{
-			for (size_t x = 0; x < VGA_WIDTH; x++)
-			{
-				vgaBuffer[index] = vgaBuffer[index + VGA_WIDTH];
-				index++;
-			}
-		}
+		mem_move(&vgaBuffer[VGA_WIDTH], vgaBuffer, (VGA_HEIGHT - 1) * VGA_WIDTH * sizeof(uint16_t));
 		
 		// clear the last row
 		const size_t rowBegin = activeRow * VGA_WIDTH;
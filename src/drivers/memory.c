@@ -1,138 +1,417 @@
 #include <drivers/memory.h>
+#include <drivers/frame.h>
+#include <drivers/memprofile.h>
 #include <c/string.h>
 #include <drivers/io/terminal.h>
 #include <kernel.h>
+#include <assembly.h>
 
-// Memory size constants
-#define MEMORY_SIZE_MEGABYTES 0x10
-#define MEMORY_SIZE_BYTES (MEMORY_SIZE_MEGABYTES << 20)
-#define MEMORY_SIZE_IN_TYPE (MEMORY_SIZE_MEGABYTES << 18) // SIZE / 4 (memory uses 4 Byte integer type)
-#define MEMORY_USED_BYTES_PER_ELEMENT 0x20 // 32 bit integer type used for memory usage
-#define MEMORY_USED_SIZE (MEMORY_SIZE_MEGABYTES << 15) // SIZE / 32 (memused uses 32 bit integer type)
+// The heap grows by at least this many bytes at a time
+#define MEMORY_GROW_SIZE 0x400000
 
 // Dynamic memory is being allocated / deallocated DYNAMIC_SEGMENT_SIZE bytes at a time
 #define DYNAMIC_SEGMENT_SIZE 0x20
-#define DYNAMIC_SEGMENT_LIMIT (MEMORY_SIZE_MEGABYTES << 15) // memory size in Bytes / segment size
+#define DYNAMIC_SEGMENT_LIMIT 0x20000 // maximum number of dynamic segments allocated at once, must be a power of 2
+
+// Each bit in memused represents a single DYNAMIC_SEGMENT_SIZE block of memory
+#define MEMORY_USED_BLOCKS_PER_ELEMENT 0x20 // 32 bit integer type used for memory usage
+// Returned instead of a block index when there is no block that could be used
+#define MEMORY_BLOCK_NONE ((size_t)-1)
+
+// Shorter copies / fills are done one byte at a time, aligning them isn't worth it
+#define MEMORY_WORD_THRESHOLD 0x10
+
+// Small allocations are served from size-class slabs, each slab occupies a single page of memory
+#define SLAB_PAGE_SIZE FRAME_SIZE
+#define SLAB_PAGE_BLOCKS (SLAB_PAGE_SIZE / DYNAMIC_SEGMENT_SIZE)
+#define SLAB_CLASS_COUNT 5 // 32, 64, 128, 256 and 512 Byte objects
+#define SLAB_OBJECT_SIZE_MAX (DYNAMIC_SEGMENT_SIZE << (SLAB_CLASS_COUNT - 1))
+#define SLAB_OBJECT_COUNT_MAX (SLAB_PAGE_SIZE / DYNAMIC_SEGMENT_SIZE)
+
+// Large allocations are served by a buddy allocator, which splits superblocks into power-of-two multiples of a page
+#define BUDDY_PAGE_SIZE SLAB_PAGE_SIZE
+#define BUDDY_ORDER_COUNT 9 // 4 KiB, 8 KiB, ... up to 1 MiB blocks
+#define BUDDY_BLOCK_SIZE_MAX (BUDDY_PAGE_SIZE << (BUDDY_ORDER_COUNT - 1)) // size of a superblock
+#define BUDDY_BLOCK_BLOCKS_MAX (BUDDY_BLOCK_SIZE_MAX / DYNAMIC_SEGMENT_SIZE)
+
+// State of the first page of a buddy block, the other pages of the block are always 0
+#define BUDDY_PAGE_FREE 0x80 // page begins a free buddy block
+#define BUDDY_PAGE_USED 0x40 // page begins an allocated buddy block
+#define BUDDY_PAGE_REGION 0x20 // page belongs to a region chunk, set on every page of the chunk
+#define BUDDY_PAGE_ORDER 0x1F // order of the block that begins at the page
+
+// Short-lived objects are bump-allocated from chunks owned by the innermost memory region
+#define REGION_DEPTH_MAX 0x10 // maximum number of regions active at once
+#define REGION_CHUNK_SIZE 0x10000
+#define REGION_OBJECT_ALIGN 0x08
+// Objects bigger than this get a chunk of their own, so that the current chunk isn't wasted
+#define REGION_OBJECT_SIZE_LARGE (REGION_CHUNK_SIZE / 4)
+
+// Bytes of metadata needed for each page of the heap (memused bits, slab and buddy page state)
+#define MEMORY_PAGE_METADATA_SIZE (SLAB_PAGE_BLOCKS / 8 + sizeof(struct SLAB) + 1)
+
+// Describes a single slab page, stored outside of the page itself
+struct SLAB
+{
+    struct SLAB* prev; // previous partially used slab of the same size class
+    struct SLAB* next; // next partially used slab of the same size class
+    void* freelist; // first free object, each free object holds a pointer to the next one
+    uint32_t objused[SLAB_OBJECT_COUNT_MAX / 32]; // allocation state of each object, used to detect invalid frees
+    uint16_t freecount; // number of free objects in the slab
+    uint8_t sizeclass; // size class of the objects + 1 (0 means the page isn't a slab)
+};
+
+// Stored at the beginning of each free buddy block
+struct BUDDY
+{
+    struct BUDDY* prev; // previous free buddy block of the same order
+    struct BUDDY* next; // next free buddy block of the same order
+};
 
-static uint32_t memory[MEMORY_SIZE_IN_TYPE];
-static uint32_t memused[MEMORY_USED_SIZE];
-static size_t memstartbyte = (size_t)memory;
+// Stored at the beginning of each region chunk, objects are placed right after it
+struct REGION_CHUNK
+{
+    struct REGION_CHUNK* next; // chunk that was allocated for the same region before this one
+    size_t size; // size of the whole chunk including this header
+    size_t used; // offset of the first byte that hasn't been handed out yet
+    size_t depth; // index of the region the chunk belongs to
+};
+
+// Stored right before each object allocated from a region
+struct REGION_OBJECT
+{
+    struct REGION_CHUNK* chunk; // chunk the object has been allocated from
+    size_t size; // number of bytes the object can hold
+};
+
+// The heap begins at a frame boundary, which makes slab pages page-aligned in absolute addresses as well
+static size_t memstartbyte = 0;
+// Number of bytes the heap currently spans, it's grown using unused frames that follow it
+static size_t memsize = 0;
+static size_t memblockcount = 0;
+// The heap can't grow beyond the run of frames it has been placed into
+static size_t memsizemax = 0;
+
+// Metadata arrays are placed in frames right before the heap and sized for its maximum size
+static uint32_t* memused = (uint32_t*)0;
+
+// Index of the first block that might be unallocated, all the blocks before it are always allocated
+static size_t memfreehint = 0;
+
+// Allocator statistics are kept up to date by the allocation functions themselves
+static size_t memusedblocks = 0;
+static size_t mempeakblocks = 0;
+static size_t memallocated = 0;
+static size_t memsegments = 0;
+// Longest run of unallocated blocks, kept up to date by every (un)allocation
+static size_t memlargestbegin = 0;
+static size_t memlargestend = 0;
+static bool memlargestvalid = false;
+// Upper bound on the length of every other unallocated run, decides whether what's left of a split longest run is still the longest
+static size_t memotherlength = 0;
 
 static size_t dynsegbegin[DYNAMIC_SEGMENT_LIMIT];
 static size_t dynseglen[DYNAMIC_SEGMENT_LIMIT];
+static size_t dynsegcount = 0;
+
+static struct SLAB* slabs = (struct SLAB*)0;
+// Slabs with at least one free object, one list per size class
+static struct SLAB* slabpartial[SLAB_CLASS_COUNT];
+
+static uint8_t* buddypages = (uint8_t*)0;
+// Free buddy blocks, one list per order
+static struct BUDDY* buddyfree[BUDDY_ORDER_COUNT];
+
+// Chunks of each active region, the first chunk in the list is the one objects are bump-allocated from
+static struct REGION_CHUNK* regions[REGION_DEPTH_MAX];
+static size_t regiondepth = 0;
 
 void mem_init(void)
 {
-    // Clear the memory
-    for (size_t i = 0; i < MEMORY_SIZE_IN_TYPE; i++)
-    {
-        memory[i] = 0;
-    }
+    // The heap is placed into the longest run of unused physical frames
+    size_t runframes = 0;
+    uint8_t* run = (uint8_t*)frame_largest(&runframes);
+
+    // Metadata occupies the beginning of the run, the heap may grow over the rest of it
+    size_t heappages = (runframes * FRAME_SIZE) / (SLAB_PAGE_SIZE + MEMORY_PAGE_METADATA_SIZE);
+    size_t metaframes = (heappages * MEMORY_PAGE_METADATA_SIZE + FRAME_SIZE - 1) / FRAME_SIZE;
 
-    // Unallocate the memory
-    for (size_t i = 0; i < MEMORY_USED_SIZE; i++)
+    if (heappages + metaframes > runframes)
     {
-        memused[i] = 0;
+        heappages = runframes - metaframes;
     }
 
-    // Clear the dynamic segment storage
-    for (size_t i = 0; i < DYNAMIC_SEGMENT_LIMIT; i++)
+    if (!heappages || !frame_claim(run, metaframes))
     {
-        dynsegbegin[i] = 0;
-        dynseglen[i] = 0;
+        debug_print("memory.c | mem_init() | There are not enough unused frames for the heap!");
+        debug_pause();
+
+        static const char PANIC_MESSAGE[] = "Not enough memory to initialize the heap!";
+        kernel_panic(PANIC_MESSAGE);
+        return;
     }
 
+    // Metadata of each page is only cleared once the heap grows over the page
+    memused = (uint32_t*)run;
+    slabs = (struct SLAB*)(run + heappages * (SLAB_PAGE_BLOCKS / 8));
+    buddypages = (uint8_t*)(slabs + heappages);
+
+    memstartbyte = (size_t)run + metaframes * FRAME_SIZE;
+    memsize = 0;
+    memblockcount = 0;
+    memsizemax = heappages * SLAB_PAGE_SIZE;
+
+    memfreehint = 0;
+
+    memusedblocks = 0;
+    mempeakblocks = 0;
+    memallocated = 0;
+    memsegments = 0;
+    memlargestvalid = false;
+
+    // The dynamic segment storage and the slab / buddy lists are in .bss,
+    // which has already been zeroed by the bootloader when it loaded the kernel
+    dynsegcount = 0;
+    regiondepth = 0;
+
     term_writeline("Memory initialized.", false);
 }
 
-bool _getused(const size_t relbyte)
+// Converts a length in bytes to the number of blocks required to store it
+static inline size_t _toblocks(const size_t length)
+{
+    return (length + DYNAMIC_SEGMENT_SIZE - 1) / DYNAMIC_SEGMENT_SIZE;
+}
+
+// Finds the first block within [block, limit) whose allocation state equals isused
+// Skips whole memused elements at a time, returns limit if there is no such block
+size_t _scanused(size_t block, const size_t limit, const bool isused)
 {
-    if (relbyte > MEMORY_SIZE_BYTES)
+    while (block < limit)
     {
-        debug_print("memory.c | _getused() | Byte index is outside of memory boundaries!");
-        return false;
+        size_t elemidx = block / MEMORY_USED_BLOCKS_PER_ELEMENT;
+        size_t bitidx = block % MEMORY_USED_BLOCKS_PER_ELEMENT;
+
+        // Bits set in this value represent the blocks we're looking for
+        uint32_t elem = (isused ? memused[elemidx] : ~memused[elemidx]);
+        // Ignore the blocks before the one the scan starts at
+        elem &= ~((uint32_t)0) << bitidx;
+
+        if (elem)
+        {
+            size_t found = block - bitidx + __builtin_ctz(elem);
+            return (found < limit ? found : limit);
+        }
+
+        // Nothing found in this element, move on to the next one
+        block += MEMORY_USED_BLOCKS_PER_ELEMENT - bitidx;
     }
 
-    size_t usedbyte = relbyte / MEMORY_USED_BYTES_PER_ELEMENT;
-    size_t usedbit = relbyte % MEMORY_USED_BYTES_PER_ELEMENT;
+    return limit;
+}
 
-    return (memused[usedbyte] & (1 << usedbit));
+// Returns the index of the block right after the end of the unallocated run that begins at block
+// Blocks beyond the end of the heap count as unallocated as long as the heap can grow over them
+size_t _freerunend(const size_t block)
+{
+    size_t end = _scanused(block, memblockcount, true);
+    return (end == memblockcount ? memsizemax / DYNAMIC_SEGMENT_SIZE : end);
 }
 
-void _setused(const size_t relbyte, const bool isused)
+// Returns the index of the first block of the unallocated run that ends right before block
+size_t _freerunbegin(size_t block)
 {
-    if (relbyte > MEMORY_SIZE_BYTES)
+    while (block > 0)
     {
-        debug_print("memory.c | _setused() | Byte index is outside of memory boundaries!");
-        return;
+        size_t elemidx = (block - 1) / MEMORY_USED_BLOCKS_PER_ELEMENT;
+        size_t bitidx = (block - 1) % MEMORY_USED_BLOCKS_PER_ELEMENT;
+
+        // Ignore the blocks at and after the one the scan starts at
+        uint32_t elem = memused[elemidx] & (~((uint32_t)0) >> (MEMORY_USED_BLOCKS_PER_ELEMENT - 1 - bitidx));
+
+        // The run begins right after the last allocated block
+        if (elem)
+        {
+            return elemidx * MEMORY_USED_BLOCKS_PER_ELEMENT + MEMORY_USED_BLOCKS_PER_ELEMENT - __builtin_clz(elem);
+        }
+
+        block -= bitidx + 1;
     }
 
-    size_t usedbyte = relbyte / MEMORY_USED_BYTES_PER_ELEMENT;
-    size_t usedbit = relbyte % MEMORY_USED_BYTES_PER_ELEMENT;
+    return 0;
+}
+
+// Keeps track of the longest unallocated run after count blocks beginning at block have been (un)allocated
+void _updatelargest(const size_t block, const size_t count, const bool isused)
+{
+    if (!memlargestvalid)
+    {
+        return;
+    }
 
     if (isused)
     {
-        memused[usedbyte] |= (1 << usedbit);
+        // Allocated blocks were unallocated, so if they overlap the longest run, they lie entirely within it
+        if (block < memlargestend && block + count > memlargestbegin)
+        {
+            size_t before = block - memlargestbegin;
+            size_t after = memlargestend - (block + count);
+
+            // The longer remaining part stays the longest run as long as no other run can be longer
+            if (after >= before && after >= memotherlength)
+            {
+                memlargestbegin = block + count;
+                memotherlength = (before > memotherlength ? before : memotherlength);
+            }
+            else if (before > after && before >= memotherlength)
+            {
+                memlargestend = block;
+                memotherlength = (after > memotherlength ? after : memotherlength);
+            }
+            else
+            {
+                // Another run may be longer now, it can only be found by scanning the whole heap
+                memlargestvalid = false;
+            }
+        }
     }
     else
     {
-        memused[usedbyte] &= ~(1 << usedbit);
+        // The unallocated blocks may have joined the runs around them into a longer one
+        size_t begin = _freerunbegin(block);
+        size_t end = _freerunend(block);
+
+        if (end - begin > memlargestend - memlargestbegin)
+        {
+            // The previous longest run becomes one of the other runs, unless it's part of the new one
+            if (begin > memlargestbegin || end < memlargestend)
+            {
+                size_t previous = memlargestend - memlargestbegin;
+                memotherlength = (previous > memotherlength ? previous : memotherlength);
+            }
+
+            memlargestbegin = begin;
+            memlargestend = end;
+        }
+        else if (end - begin > memotherlength)
+        {
+            memotherlength = end - begin;
+        }
     }
 }
 
-// Counts allocated bytes in memory
-size_t mem_used(void)
+// Marks count blocks starting at block as allocated / unallocated
+// Works with whole memused elements wherever possible
+void _setused(size_t block, size_t count, const bool isused)
 {
-    size_t count = 0;
-    size_t tmpused = 0;
+    if (block + count > memblockcount)
+    {
+        debug_print("memory.c | _setused() | Block index is outside of memory boundaries!");
+        return;
+    }
+
+    const size_t firstblock = block;
+    const size_t blockcount = count;
 
-    for (size_t i = 0; i < MEMORY_USED_SIZE; i++)
+    while (count > 0)
     {
-        if (memused[i])
+        size_t bitidx = block % MEMORY_USED_BLOCKS_PER_ELEMENT;
+        size_t bitcount = MEMORY_USED_BLOCKS_PER_ELEMENT - bitidx;
+
+        if (bitcount > count)
         {
-            tmpused = memused[i];
-            
-            while (tmpused > 0)
-            {
-                // Get the last bit
-                count += (tmpused & 0x1);
-                tmpused = tmpused >> 1;
-            }
+            bitcount = count;
+        }
+
+        uint32_t mask = (bitcount == MEMORY_USED_BLOCKS_PER_ELEMENT ? ~((uint32_t)0) : ((((uint32_t)1) << bitcount) - 1) << bitidx);
+
+        if (isused)
+        {
+            memusedblocks += __builtin_popcount(mask & ~memused[block / MEMORY_USED_BLOCKS_PER_ELEMENT]);
+            memused[block / MEMORY_USED_BLOCKS_PER_ELEMENT] |= mask;
+        }
+        else
+        {
+            memusedblocks -= __builtin_popcount(mask & memused[block / MEMORY_USED_BLOCKS_PER_ELEMENT]);
+            memused[block / MEMORY_USED_BLOCKS_PER_ELEMENT] &= ~mask;
         }
+
+        block += bitcount;
+        count -= bitcount;
     }
 
-    return count;
+    if (memusedblocks > mempeakblocks)
+    {
+        mempeakblocks = memusedblocks;
+    }
+
+    _updatelargest(firstblock, blockcount, isused);
+}
+
+// Counts allocated bytes in memory
+size_t mem_used(void)
+{
+    return memusedblocks * DYNAMIC_SEGMENT_SIZE;
 }
 
-// Counts unallocated bytes in memory
+// Counts unallocated bytes in memory, including the ones the heap can still grow over
 size_t mem_empty(void)
 {
-    size_t count = MEMORY_SIZE_BYTES;
-    size_t tmpused = 0;
+    return memsizemax - mem_used();
+}
 
-    for (size_t i = 0; i < MEMORY_USED_SIZE; i++)
+// Returns the length of the longest run of unallocated bytes
+// The heap is only scanned at first and when an allocation splits the longest run while another run may be longer
+size_t _largestfree(void)
+{
+    if (!memlargestvalid)
     {
-        if (memused[i])
+        // The run at the end of the heap includes the part the heap can still grow over
+        size_t trailing = _freerunbegin(memblockcount);
+        memlargestbegin = trailing;
+        memlargestend = memsizemax / DYNAMIC_SEGMENT_SIZE;
+        memotherlength = 0;
+
+        for (size_t begin = _scanused(0, memblockcount, false); begin < trailing; )
         {
-            tmpused = memused[i];
-            
-            while (tmpused > 0)
+            size_t end = _scanused(begin, memblockcount, true);
+            size_t longest = memlargestend - memlargestbegin;
+
+            if (end - begin > longest)
             {
-                // Get the last bit
-                count -= (tmpused & 0x1);
-                tmpused = tmpused >> 1;
+                memotherlength = (longest > memotherlength ? longest : memotherlength);
+                memlargestbegin = begin;
+                memlargestend = end;
             }
+            else if (end - begin > memotherlength)
+            {
+                memotherlength = end - begin;
+            }
+
+            begin = _scanused(end, memblockcount, false);
         }
+
+        memlargestvalid = true;
     }
 
-    return count;
+    return (memlargestend - memlargestbegin) * DYNAMIC_SEGMENT_SIZE;
+}
+
+void mem_stats(struct MEM_STATS* const stats)
+{
+    stats->used = mem_used();
+    stats->empty = mem_empty();
+    stats->peak = mempeakblocks * DYNAMIC_SEGMENT_SIZE;
+    stats->allocated = memallocated;
+    stats->segments = memsegments;
+    stats->largestfree = _largestfree();
 }
 
 // Returns true if ptrbyte is within memory boundaries
 bool _inmemory(const size_t ptrbyte)
 {
     // Determines whether the pointer ptr is within memory boundaries
-    return (ptrbyte >= memstartbyte && ptrbyte < memstartbyte + MEMORY_SIZE_BYTES);
+    return (ptrbyte >= memstartbyte && ptrbyte < memstartbyte + memsize);
 }
 
 // Returns true if ptr is within memory boundaries
@@ -154,19 +433,50 @@ size_t _toreladdressptr(const void* const ptr)
     return (size_t)ptr - memstartbyte;
 }
 
+// Dynamic segments are stored in an open-addressed hash table keyed by their relative address
+// A slot is empty if the segment length stored in it is 0
+static inline size_t _dynseghash(const size_t beginrel)
+{
+    // Fibonacci hashing spreads neighbouring segments across the whole storage
+    return (((uint32_t)(beginrel / DYNAMIC_SEGMENT_SIZE)) * 0x9E3779B1) >> (32 - __builtin_ctz(DYNAMIC_SEGMENT_LIMIT));
+}
+
+// Finds the slot storing the segment with specified beginning address
+// Returns DYNAMIC_SEGMENT_LIMIT if there is no such segment
+size_t _dynsegfind(const size_t beginrel)
+{
+    // Segments are stored in the first empty slot following the slot the hash points to
+    for (size_t i = _dynseghash(beginrel); dynseglen[i]; i = (i + 1) % DYNAMIC_SEGMENT_LIMIT)
+    {
+        if (dynsegbegin[i] == beginrel)
+        {
+            return i;
+        }
+    }
+
+    return DYNAMIC_SEGMENT_LIMIT;
+}
+
 // Same as _statsegstore() except for dynamic memory segment
 void _dynsegstore(const size_t beginrel, const size_t length)
 {
-    for (size_t i = 0; i < DYNAMIC_SEGMENT_LIMIT; i++)
+    // There must always be at least one empty slot, otherwise lookups would never end
+    if (dynsegcount + 1 < DYNAMIC_SEGMENT_LIMIT)
     {
-        // Find empty spot in the static segment storage
-        if (!dynseglen[i])
+        size_t i = _dynseghash(beginrel);
+
+        // Find empty spot in the dynamic segment storage
+        while (dynseglen[i])
         {
-            dynsegbegin[i] = beginrel;
-            dynseglen[i] = length;
-            // New dynamic segment has been stored successfully
-            return;
+            i = (i + 1) % DYNAMIC_SEGMENT_LIMIT;
         }
+
+        dynsegbegin[i] = beginrel;
+        dynseglen[i] = length;
+        dynsegcount++;
+        memallocated += length;
+        // New dynamic segment has been stored successfully
+        return;
     }
 
     // The dynamic segment storage is already full
@@ -178,20 +488,42 @@ void _dynsegstore(const size_t beginrel, const size_t length)
     kernel_panic(PANIC_MESSAGE);
 }
 
-// Finds a segments by its relative beginning address and returns its length
-size_t _seglen(const size_t beginrel)
+// Removes a segment from the dynamic segment storage
+void _dynsegremove(size_t slot)
 {
-    // Scan through dynamic memory segments
-    for (size_t i = 0; i < DYNAMIC_SEGMENT_LIMIT; i++)
+    memallocated -= dynseglen[slot];
+
+    // Segments following the removed one are shifted back to fill the gap,
+    // so that none of them becomes unreachable from the slot its hash points to
+    for (size_t i = (slot + 1) % DYNAMIC_SEGMENT_LIMIT; dynseglen[i]; i = (i + 1) % DYNAMIC_SEGMENT_LIMIT)
     {
-        // Find the segment with specified beginning address in segment storage
-        if (dynsegbegin[i] == beginrel && dynseglen[i] > 0)
+        size_t home = _dynseghash(dynsegbegin[i]);
+
+        // The segment can only be moved if the gap isn't located before its home slot
+        if (((i - home) % DYNAMIC_SEGMENT_LIMIT) >= ((i - slot) % DYNAMIC_SEGMENT_LIMIT))
         {
-            // Segment found, return its length
-            return dynseglen[i];
+            dynsegbegin[slot] = dynsegbegin[i];
+            dynseglen[slot] = dynseglen[i];
+            slot = i;
         }
     }
 
+    dynsegbegin[slot] = 0;
+    dynseglen[slot] = 0;
+    dynsegcount--;
+}
+
+// Finds a segments by its relative beginning address and returns its length
+size_t _seglen(const size_t beginrel)
+{
+    size_t i = _dynsegfind(beginrel);
+
+    // Segment found, return its length
+    if (i < DYNAMIC_SEGMENT_LIMIT)
+    {
+        return dynseglen[i];
+    }
+
     // Segment not found
     debug_print("memory.c | _seglen() | Memory segment couldn't be found!");
     debug_pause();
@@ -201,61 +533,134 @@ size_t _seglen(const size_t beginrel)
     return 0;
 }
 
-// Used by dynalloc() to avoid redundant code
-// _alloc() shall NOT be accessed externally, it should be only used locally for the sake of safety
-void* _alloc(const size_t length)
+// Makes at least length more bytes at the end of the heap usable
+// Returns false if the heap can't grow that much
+bool _grow(const size_t length)
 {
-    // Empty space cannot be allocated
-    if (length == 0)
+    size_t growth = (length > MEMORY_GROW_SIZE ? length : MEMORY_GROW_SIZE);
+    growth = ((growth + SLAB_PAGE_SIZE - 1) / SLAB_PAGE_SIZE) * SLAB_PAGE_SIZE;
+
+    if (growth > memsizemax - memsize)
     {
-        debug_print("memory.c | _alloc() | Can't allocate an empty space!");
-        debug_pause();
+        growth = memsizemax - memsize;
+    }
 
-        static const char PANIC_MESSAGE[] = "Cannot allocate zero bytes of memory space!";
-        kernel_panic(PANIC_MESSAGE);
-        return (void*)0;
+    // Frames right after the heap might have been taken by someone else in the meantime
+    size_t frames = frame_run((void*)(memstartbyte + memsize));
+
+    if (growth > frames * FRAME_SIZE)
+    {
+        growth = frames * FRAME_SIZE;
     }
 
-    // Find first unallocated byte
-    for (size_t i = 0; i < (MEMORY_SIZE_BYTES - (length - 1)); i++)
+    if (growth < length || !frame_claim((void*)(memstartbyte + memsize), growth / FRAME_SIZE))
     {
-        // If byte is not allocated
-        if (!_getused(i))
-        {
-            bool spacefound = true;
+        debug_print("memory.c | _grow() | The heap can't grow any further!");
+        return false;
+    }
+
+    // Unallocate the new pages and mark them as not used by slabs / buddy blocks
+    // The pages themselves aren't cleared, allocated memory is never guaranteed to be zeroed
+    size_t firstpage = memsize / SLAB_PAGE_SIZE;
+    size_t pages = growth / SLAB_PAGE_SIZE;
+
+    mem_set(&memused[firstpage * (SLAB_PAGE_BLOCKS / MEMORY_USED_BLOCKS_PER_ELEMENT)], 0, pages * (SLAB_PAGE_BLOCKS / 8));
+    mem_set(&slabs[firstpage], 0, pages * sizeof(struct SLAB));
+    mem_set(&buddypages[firstpage], 0, pages);
+
+    memsize += growth;
+    memblockcount = memsize / DYNAMIC_SEGMENT_SIZE;
+    return true;
+}
+
+// Finds and allocates a run of unallocated blocks, the index of its first block plus skew is a multiple of align
+// Alignment relative to the beginning of the heap is used by buddy blocks, skew makes the alignment absolute
+// Grows the heap if there is no such run in it yet
+// Returns the index of the first allocated block or MEMORY_BLOCK_NONE if there is no such run
+size_t _findblocks(const size_t blocks, const size_t align, const size_t skew)
+{
+    // All the blocks before the hint are allocated, there's no need to scan them
+    size_t begin = _scanused(memfreehint, memblockcount, false);
+    memfreehint = begin;
+
+    // Go through the runs of unallocated blocks until one that is long enough is found
+    while (true)
+    {
+        // Move the beginning of the run to the nearest properly aligned block
+        begin = ((begin + skew + align - 1) / align) * align - skew;
 
-            // Check is there are enough unallocated bytes
-            for (size_t j = 0; j < length; j++)
+        if (begin + blocks > memblockcount)
+        {
+            // The run must be checked again after the heap grows, it may not be unallocated at all
+            if (_grow((begin + blocks - memblockcount) * DYNAMIC_SEGMENT_SIZE))
             {
-                if (_getused(i + j))
-                {
-                    spacefound = false;
-                    break;
-                }
+                continue;
             }
 
-            // If there are enough unallocated bytes
-            if (spacefound)
+            break;
+        }
+
+        // Only the blocks that would be occupied by the allocation need to be checked
+        size_t end = _scanused(begin, begin + blocks, true);
+
+        // If there are enough unallocated blocks
+        if (end == begin + blocks)
+        {
+            // Allocate those blocks
+            _setused(begin, blocks, true);
+
+            // The allocation has been placed at the beginning of the first unallocated run
+            if (begin == memfreehint)
             {
-                // Allocate those bytes
-                for (size_t j = 0; j < length; j++)
-                {
-                    _setused(i + j, true);
-                }
-
-                // Return pointer to the first recently allocated byte
-                return (void*)(memstartbyte + i);
+                memfreehint = end;
             }
+
+            return begin;
         }
+
+        // Skip the allocated blocks that interrupted the run
+        begin = _scanused(end, memblockcount, false);
+    }
+
+    return MEMORY_BLOCK_NONE;
+}
+
+// Same as _findblocks() except it panics if the blocks can't be allocated
+size_t _allocblocks(const size_t blocks, const size_t align, const size_t skew)
+{
+    size_t begin = _findblocks(blocks, align, skew);
+
+    if (begin != MEMORY_BLOCK_NONE)
+    {
+        return begin;
     }
 
     // There isn't enough space in the memory to allocate the desired amout of bytes
-    debug_print("memory.c | _alloc() | Not enough space in the memory to perform the allocation!");
+    debug_print("memory.c | _allocblocks() | Not enough space in the memory to perform the allocation!");
     debug_pause();
     // Further code execution might not be safe
     static const char PANIC_MESSAGE[] = "Failed to allocate the requested amount of memory space!";
     kernel_panic(PANIC_MESSAGE);
-    return (void*)0;
+    return 0;
+}
+
+// Used by dynalloc() to avoid redundant code
+// _alloc() shall NOT be accessed externally, it should be only used locally for the sake of safety
+void* _alloc(const size_t length)
+{
+    // Empty space cannot be allocated
+    if (length == 0)
+    {
+        debug_print("memory.c | _alloc() | Can't allocate an empty space!");
+        debug_pause();
+
+        static const char PANIC_MESSAGE[] = "Cannot allocate zero bytes of memory space!";
+        kernel_panic(PANIC_MESSAGE);
+        return (void*)0;
+    }
+
+    // Return pointer to the first recently allocated byte
+    return (void*)(memstartbyte + (_allocblocks(_toblocks(length), 1, 0) * DYNAMIC_SEGMENT_SIZE));
 }
 
 // Internal function used for unallocating space in memory
@@ -263,146 +668,706 @@ void* _alloc(const size_t length)
 // length - amout of bytes to unallocate
 void _free(const size_t beginrel, const size_t length)
 {
-    for (size_t i = 0; i < length; i++)
+    size_t block = beginrel / DYNAMIC_SEGMENT_SIZE;
+
+    _setused(block, _toblocks(length), false);
+
+    // The freed blocks may now be the first unallocated ones
+    if (block < memfreehint)
     {
-        _setused(beginrel + i, false);
+        memfreehint = block;
     }
 }
 
-// Unallocates memory segment starting at address stored in ptr
-void mem_free(const void* const ptr)
+// Returns the size class used to store objects of the specified size
+size_t _slabclass(const size_t size)
 {
-    if (!ptr)
-    {
-        // This should never occurr under standard circumstances
-        // There must be something wrong and further damage must be prevented
-        debug_print("memory.c | mem_free() | Can't free a nullptr!");
-        debug_pause();
+    size_t sizeclass = 0;
 
-        static const char PANIC_MESSAGE[] = "Cannot unallocate memory space at nullptr!";
-        kernel_panic(PANIC_MESSAGE);
-        return;
-    }
+    while ((size_t)(DYNAMIC_SEGMENT_SIZE << sizeclass) < size)
+        sizeclass++;
 
-    // Convert from pointer to size_t to make mathematical operations possible
-    size_t ptrbyte = (size_t)ptr;
+    return sizeclass;
+}
 
-    // If the pointer points outside the memory boundaries it should be ignored
-    if (!_inmemory(ptrbyte))
-    {
-        // Same as the free(nullptr) case, it should never happen in correct code
-        debug_print("memory.c | mem_free() | Can't free a pointer outside of memory boundaries!");
-        debug_pause();
+// Returns the slab the pointer belongs to or nullptr if it doesn't point into a slab page
+struct SLAB* _slabfind(const size_t beginrel)
+{
+    struct SLAB* slab = &slabs[beginrel / SLAB_PAGE_SIZE];
+    return (slab->sizeclass ? slab : (struct SLAB*)0);
+}
 
-        static const char PANIC_MESSAGE[] = "Cannot unallocate memory space outside of memory boundaries!";
-        kernel_panic(PANIC_MESSAGE);
-        return;
+// Removes a slab from the list of partially used slabs of its size class
+void _slabunlink(struct SLAB* const slab)
+{
+    if (slab->prev)
+    {
+        slab->prev->next = slab->next;
     }
-
-    // Calculate the relative address of the beginning of the segment
-    size_t beginrel = _toreladdress(ptrbyte);
-
-    // If there is no such static segment it will now assume it may be a dynamic segment
-    for (size_t i = 0; i < DYNAMIC_SEGMENT_LIMIT; i++)
+    else
     {
-        // Find the segment with specified beginning address in segment storage
-        if (dynsegbegin[i] == beginrel && dynseglen[i] > 0)
-        {
-            _free(beginrel, dynseglen[i]);
-
-            dynsegbegin[i] = 0;
-            dynseglen[i] = 0;
-
-            // Dynamic segment has successfully been found and deleted
-            return;
-        }
+        slabpartial[slab->sizeclass - 1] = slab->next;
     }
 
-    // Attempt to free memory space that was not allocated
-    // There must be something wrong with the code if this happens
-    debug_print("memory.c | mem_free() | Pointer couldn't be freed because it wasn't found as allocated!");
-    debug_pause();
+    if (slab->next)
+    {
+        slab->next->prev = slab->prev;
+    }
 
-    static const char PANIC_MESSAGE[] = "Cannot unallocate memory space that is not allocated!";
-    kernel_panic(PANIC_MESSAGE);
+    slab->prev = (struct SLAB*)0;
+    slab->next = (struct SLAB*)0;
 }
 
-// Unsafe local extension of copy() that allows copying bytes from outside of the memory boundaries
-void* _copy(const void* const ptrsrc, const size_t length)
+// Adds a slab to the beginning of the list of partially used slabs of its size class
+void _slablink(struct SLAB* const slab)
 {
-    uint8_t* ptrsrcbyte = (uint8_t*)ptrsrc;
-    void* ptrdst = _alloc(length);
-    uint8_t* ptrdstbyte = (uint8_t*)ptrdst;
+    struct SLAB** head = &slabpartial[slab->sizeclass - 1];
+
+    slab->prev = (struct SLAB*)0;
+    slab->next = *head;
 
-    for (size_t i = 0; i < length; i++)
+    if (*head)
     {
-        ptrdstbyte[i] = ptrsrcbyte[i];
+        (*head)->prev = slab;
     }
 
-    return ptrdst;
+    *head = slab;
 }
 
-// Copy a specified amount of bytes from source to destination
-void mem_copy(const void* const ptrsrc, const void* const ptrdst, const size_t length)
+// Turns a newly allocated page into an empty slab of the specified size class
+struct SLAB* _slabcreate(const size_t sizeclass)
 {
-    uint8_t* byteptrsrc = (uint8_t*)ptrsrc;
-    uint8_t* byteptrdst = (uint8_t*)ptrdst;
+    // Slab pages must be page-aligned so that an object's slab can be found from its address
+    size_t pageblock = _allocblocks(SLAB_PAGE_BLOCKS, SLAB_PAGE_BLOCKS, 0);
+    size_t pagerel = pageblock * DYNAMIC_SEGMENT_SIZE;
 
-    for (size_t i = 0; i < length; i++)
+    struct SLAB* slab = &slabs[pagerel / SLAB_PAGE_SIZE];
+    size_t objsize = DYNAMIC_SEGMENT_SIZE << sizeclass;
+    size_t objcount = SLAB_PAGE_SIZE / objsize;
+
+    // Chain all the objects in the page into the free list
+    uint8_t* page = (uint8_t*)(memstartbyte + pagerel);
+
+    for (size_t i = 0; i < objcount; i++)
     {
-        byteptrdst[i] = byteptrsrc[i];
+        *(void**)&page[i * objsize] = (i + 1 < objcount ? (void*)&page[(i + 1) * objsize] : (void*)0);
     }
-}
 
-// Finds the smallest dynamic segment size with at least segsize bytes
-size_t _dynfindsize(const size_t segsize)
-{
-    size_t allocsize = DYNAMIC_SEGMENT_SIZE;
-    
-    while (allocsize < segsize)
-        allocsize += DYNAMIC_SEGMENT_SIZE;
+    slab->freelist = page;
+    slab->freecount = objcount;
+    slab->sizeclass = sizeclass + 1;
+    mem_set(slab->objused, 0, sizeof(slab->objused));
 
-    return allocsize;
+    _slablink(slab);
+    return slab;
 }
 
-// Allocates dynamic memory segment
-void* mem_dynalloc(const size_t initsize)
+// Allocates an object from a slab of the specified size class
+void* _slaballoc(const size_t sizeclass)
 {
-    size_t allocsize = _dynfindsize(initsize);
-    void* allocptr = _alloc(allocsize);    
-    _dynsegstore(_toreladdressptr(allocptr), allocsize);
-    return allocptr;
-}
+    struct SLAB* slab = slabpartial[sizeclass];
 
-// Used when resizing dynamic memory segment
-// Returns true if all the bytes within specified range are unallocated
-bool _unallocated(const size_t beginrel, const size_t length)
-{
-    // Can't tell whether the memory is allocated or not if the
-    // requested range is outside availible memory's boundaries
-    if (beginrel + length >= MEMORY_SIZE_BYTES)
+    // There is no slab with a free object, a new one must be created
+    if (!slab)
     {
-        debug_print("memory.c | _unallocated() | Requested range is outside of memory boundaries!");
-        return false;
+        slab = _slabcreate(sizeclass);
     }
 
-    for (size_t i = 0; i < length; i++)
+    // Pop the first object from the free list
+    void* obj = slab->freelist;
+    slab->freelist = *(void**)obj;
+    slab->freecount--;
+
+    size_t objidx = (_toreladdressptr(obj) % SLAB_PAGE_SIZE) >> (sizeclass + 5);
+    slab->objused[objidx / 32] |= ((uint32_t)1) << (objidx % 32);
+    memallocated += DYNAMIC_SEGMENT_SIZE << sizeclass;
+
+    // A full slab can't be used for further allocations
+    if (!slab->freecount)
+    {
+        _slabunlink(slab);
+    }
+
+    return obj;
+}
+
+// Returns an object to its slab, panics if the object isn't allocated
+void _slabfree(struct SLAB* const slab, void* const obj)
+{
+    size_t sizeclass = slab->sizeclass - 1;
+    size_t offset = _toreladdressptr(obj) % SLAB_PAGE_SIZE;
+    size_t objidx = offset >> (sizeclass + 5);
+    uint32_t objmask = ((uint32_t)1) << (objidx % 32);
+
+    // The pointer must point at the beginning of an allocated object
+    if ((offset & ((DYNAMIC_SEGMENT_SIZE << sizeclass) - 1)) || !(slab->objused[objidx / 32] & objmask))
+    {
+        debug_print("memory.c | _slabfree() | Pointer couldn't be freed because it wasn't found as allocated!");
+        debug_pause();
+
+        static const char PANIC_MESSAGE[] = "Cannot unallocate memory space that is not allocated!";
+        kernel_panic(PANIC_MESSAGE);
+        return;
+    }
+
+    slab->objused[objidx / 32] &= ~objmask;
+    memallocated -= DYNAMIC_SEGMENT_SIZE << sizeclass;
+
+    // Push the object to the beginning of the free list
+    *(void**)obj = slab->freelist;
+    slab->freelist = obj;
+    slab->freecount++;
+
+    // The slab was full, so it isn't in the list of partially used slabs
+    if (slab->freecount == 1)
+    {
+        _slablink(slab);
+    }
+
+    // Empty slabs are given back to the memory unless it's the only slab available for the size class
+    if (slab->freecount == SLAB_PAGE_SIZE >> (sizeclass + 5) && (slab->prev || slab->next))
+    {
+        _slabunlink(slab);
+        slab->sizeclass = 0;
+
+        _free(_toreladdressptr(obj) - offset, SLAB_PAGE_SIZE);
+    }
+}
+
+// Returns the smallest order of buddy blocks that can store size bytes
+size_t _buddyorder(const size_t size)
+{
+    size_t order = 0;
+
+    while ((size_t)(BUDDY_PAGE_SIZE << order) < size)
+        order++;
+
+    return order;
+}
+
+// Returns true if the address points at the beginning of an allocated buddy block
+static inline bool _isbuddy(const size_t beginrel)
+{
+    return (!(beginrel % BUDDY_PAGE_SIZE) && (buddypages[beginrel / BUDDY_PAGE_SIZE] & BUDDY_PAGE_USED));
+}
+
+// Adds a buddy block to the list of free blocks of the specified order
+void _buddylink(const size_t beginrel, const size_t order)
+{
+    struct BUDDY* block = (struct BUDDY*)(memstartbyte + beginrel);
+
+    block->prev = (struct BUDDY*)0;
+    block->next = buddyfree[order];
+
+    if (buddyfree[order])
+    {
+        buddyfree[order]->prev = block;
+    }
+
+    buddyfree[order] = block;
+    buddypages[beginrel / BUDDY_PAGE_SIZE] = BUDDY_PAGE_FREE | order;
+}
+
+// Removes a buddy block from the list of free blocks of the specified order
+void _buddyunlink(const size_t beginrel, const size_t order)
+{
+    struct BUDDY* block = (struct BUDDY*)(memstartbyte + beginrel);
+
+    if (block->prev)
+    {
+        block->prev->next = block->next;
+    }
+    else
+    {
+        buddyfree[order] = block->next;
+    }
+
+    if (block->next)
+    {
+        block->next->prev = block->prev;
+    }
+
+    buddypages[beginrel / BUDDY_PAGE_SIZE] = 0;
+}
+
+// Allocates a buddy block of the specified order
+// Returns nullptr if there is no free block and no superblock can be carved out of the memory
+void* _buddyalloc(const size_t order)
+{
+    size_t blockorder = order;
+
+    // Find the smallest free block that is big enough
+    while (blockorder < BUDDY_ORDER_COUNT && !buddyfree[blockorder])
+        blockorder++;
+
+    // There is no such block, a new superblock must be allocated
+    if (blockorder == BUDDY_ORDER_COUNT)
+    {
+        // Superblocks are aligned to their size, so that the buddy of each block can be calculated from its address
+        size_t superblock = _findblocks(BUDDY_BLOCK_BLOCKS_MAX, BUDDY_BLOCK_BLOCKS_MAX, 0);
+
+        if (superblock == MEMORY_BLOCK_NONE)
+        {
+            return (void*)0;
+        }
+
+        blockorder = BUDDY_ORDER_COUNT - 1;
+        _buddylink(superblock * DYNAMIC_SEGMENT_SIZE, blockorder);
+    }
+
+    size_t beginrel = _toreladdressptr(buddyfree[blockorder]);
+    _buddyunlink(beginrel, blockorder);
+
+    // Split the block in halves until it has the requested size, the upper halves remain free
+    while (blockorder > order)
+    {
+        blockorder--;
+        _buddylink(beginrel + (BUDDY_PAGE_SIZE << blockorder), blockorder);
+    }
+
+    buddypages[beginrel / BUDDY_PAGE_SIZE] = BUDDY_PAGE_USED | order;
+    memallocated += BUDDY_PAGE_SIZE << order;
+    return (void*)(memstartbyte + beginrel);
+}
+
+// Returns an allocated buddy block and merges it with its free buddies
+void _buddyfree(size_t beginrel)
+{
+    size_t order = buddypages[beginrel / BUDDY_PAGE_SIZE] & BUDDY_PAGE_ORDER;
+    buddypages[beginrel / BUDDY_PAGE_SIZE] = 0;
+    memallocated -= BUDDY_PAGE_SIZE << order;
+
+    // Merge the block with its buddy for as long as the buddy is free as a whole
+    while (order < BUDDY_ORDER_COUNT - 1)
+    {
+        size_t buddyrel = beginrel ^ (BUDDY_PAGE_SIZE << order);
+
+        if (buddypages[buddyrel / BUDDY_PAGE_SIZE] != (BUDDY_PAGE_FREE | order))
+        {
+            break;
+        }
+
+        _buddyunlink(buddyrel, order);
+
+        // The merged block begins where the lower of the buddies does
+        if (buddyrel < beginrel)
+        {
+            beginrel = buddyrel;
+        }
+
+        order++;
+    }
+
+    // Free superblocks are given back to the memory unless it's the only one available
+    if (order == BUDDY_ORDER_COUNT - 1 && buddyfree[order])
+    {
+        _free(beginrel, BUDDY_BLOCK_SIZE_MAX);
+        return;
+    }
+
+    _buddylink(beginrel, order);
+}
+
+// Returns true if the address points into a region chunk
+static inline bool _isregion(const size_t beginrel)
+{
+    return buddypages[beginrel / BUDDY_PAGE_SIZE] & BUDDY_PAGE_REGION;
+}
+
+// Allocates a chunk of at least size bytes for the region with the specified index
+struct REGION_CHUNK* _regionchunkalloc(const size_t size, const size_t depth)
+{
+    struct REGION_CHUNK* chunk = (struct REGION_CHUNK*)0;
+    size_t chunksize = 0;
+
+    // Chunks are buddy blocks whenever possible, so that they can be recycled quickly
+    if (size <= BUDDY_BLOCK_SIZE_MAX)
+    {
+        size_t order = _buddyorder(size);
+        chunk = (struct REGION_CHUNK*)_buddyalloc(order);
+        chunksize = BUDDY_PAGE_SIZE << order;
+    }
+
+    // Chunks that don't fit into a buddy block are page-aligned runs of blocks
+    if (!chunk)
+    {
+        chunksize = ((size + SLAB_PAGE_SIZE - 1) / SLAB_PAGE_SIZE) * SLAB_PAGE_SIZE;
+        chunk = (struct REGION_CHUNK*)(memstartbyte + _allocblocks(chunksize / DYNAMIC_SEGMENT_SIZE, SLAB_PAGE_BLOCKS, 0) * DYNAMIC_SEGMENT_SIZE);
+        memallocated += chunksize;
+    }
+
+    size_t firstpage = _toreladdressptr(chunk) / BUDDY_PAGE_SIZE;
+
+    for (size_t i = 0; i < chunksize / BUDDY_PAGE_SIZE; i++)
+    {
+        buddypages[firstpage + i] |= BUDDY_PAGE_REGION;
+    }
+
+    chunk->next = (struct REGION_CHUNK*)0;
+    chunk->size = chunksize;
+    chunk->used = sizeof(struct REGION_CHUNK);
+    chunk->depth = depth;
+
+    return chunk;
+}
+
+// Gives a region chunk back to the memory, including all the objects in it
+void _regionchunkfree(struct REGION_CHUNK* const chunk)
+{
+    size_t beginrel = _toreladdressptr(chunk);
+    size_t size = chunk->size;
+
+    for (size_t i = 0; i < size / BUDDY_PAGE_SIZE; i++)
+    {
+        buddypages[beginrel / BUDDY_PAGE_SIZE + i] &= ~BUDDY_PAGE_REGION;
+    }
+
+    if (_isbuddy(beginrel))
+    {
+        _buddyfree(beginrel);
+    }
+    else
+    {
+        _free(beginrel, size);
+        memallocated -= size;
+    }
+}
+
+// Bump-allocates an object from the region with the specified index
+void* _regionalloc(const size_t depth, const size_t size)
+{
+    size_t objsize = ((size + REGION_OBJECT_ALIGN - 1) / REGION_OBJECT_ALIGN) * REGION_OBJECT_ALIGN;
+    size_t needed = sizeof(struct REGION_OBJECT) + objsize;
+
+    struct REGION_CHUNK* chunk = regions[depth];
+
+    if (!chunk || chunk->size - chunk->used < needed)
+    {
+        if (chunk && needed > REGION_OBJECT_SIZE_LARGE)
+        {
+            // Large objects go into a chunk of their own, which is kept behind the current one
+            struct REGION_CHUNK* large = _regionchunkalloc(sizeof(struct REGION_CHUNK) + needed, depth);
+            large->next = chunk->next;
+            chunk->next = large;
+            chunk = large;
+        }
+        else
+        {
+            // The rest of the current chunk is given up, the new chunk becomes the current one
+            size_t chunksize = sizeof(struct REGION_CHUNK) + needed;
+            struct REGION_CHUNK* fresh = _regionchunkalloc(chunksize > REGION_CHUNK_SIZE ? chunksize : REGION_CHUNK_SIZE, depth);
+            fresh->next = chunk;
+            regions[depth] = fresh;
+            chunk = fresh;
+        }
+    }
+
+    struct REGION_OBJECT* obj = (struct REGION_OBJECT*)((size_t)chunk + chunk->used);
+    obj->chunk = chunk;
+    obj->size = objsize;
+    chunk->used += needed;
+
+    return (void*)(obj + 1);
+}
+
+// Begins a new memory region nested in the currently active one
+void mem_regionpush(void)
+{
+    if (regiondepth == REGION_DEPTH_MAX)
+    {
+        debug_print("memory.c | mem_regionpush() | Too many nested memory regions!");
+        debug_pause();
+
+        static const char PANIC_MESSAGE[] = "Unable to begin another memory region!";
+        kernel_panic(PANIC_MESSAGE);
+        return;
+    }
+
+    regions[regiondepth++] = (struct REGION_CHUNK*)0;
+}
+
+// Ends the innermost memory region, all the objects allocated from it are released at once
+void mem_regionpop(void)
+{
+    if (!regiondepth)
+    {
+        debug_print("memory.c | mem_regionpop() | There is no active memory region!");
+        return;
+    }
+
+    struct REGION_CHUNK* chunk = regions[--regiondepth];
+
+    while (chunk)
+    {
+        struct REGION_CHUNK* next = chunk->next;
+        _regionchunkfree(chunk);
+        chunk = next;
+    }
+}
+
+// Allocates memory from the innermost memory region, same as mem_dynalloc() if there is none
+void* mem_regionalloc(const size_t size)
+{
+    if (!regiondepth)
+    {
+        return mem_tracedalloc(size, __builtin_return_address(0));
+    }
+
+    return _regionalloc(regiondepth - 1, size);
+}
+
+// Unallocates memory segment starting at address stored in ptr
+void mem_free(const void* const ptr)
+{
+    if (!ptr)
+    {
+        // This should never occurr under standard circumstances
+        // There must be something wrong and further damage must be prevented
+        debug_print("memory.c | mem_free() | Can't free a nullptr!");
+        debug_pause();
+
+        static const char PANIC_MESSAGE[] = "Cannot unallocate memory space at nullptr!";
+        kernel_panic(PANIC_MESSAGE);
+        return;
+    }
+
+    // Convert from pointer to size_t to make mathematical operations possible
+    size_t ptrbyte = (size_t)ptr;
+
+    // If the pointer points outside the memory boundaries it should be ignored
+    if (!_inmemory(ptrbyte))
+    {
+        // Same as the free(nullptr) case, it should never happen in correct code
+        debug_print("memory.c | mem_free() | Can't free a pointer outside of memory boundaries!");
+        debug_pause();
+
+        static const char PANIC_MESSAGE[] = "Cannot unallocate memory space outside of memory boundaries!";
+        kernel_panic(PANIC_MESSAGE);
+        return;
+    }
+
+    // Calculate the relative address of the beginning of the segment
+    size_t beginrel = _toreladdress(ptrbyte);
+
+    // Objects allocated from a region are released together with the region
+    if (_isregion(beginrel))
+    {
+        return;
+    }
+
+    memprof_free(ptr);
+
+    // Small objects are stored in slabs rather than in their own dynamic segments
+    struct SLAB* slab = _slabfind(beginrel);
+    if (slab)
+    {
+        _slabfree(slab, (void*)ptr);
+        memsegments--;
+        return;
+    }
+
+    // Large objects are stored in buddy blocks
+    if (_isbuddy(beginrel))
+    {
+        _buddyfree(beginrel);
+        memsegments--;
+        return;
+    }
+
+    // If there is no such static segment it will now assume it may be a dynamic segment
+    size_t i = _dynsegfind(beginrel);
+
+    // Find the segment with specified beginning address in segment storage
+    if (i < DYNAMIC_SEGMENT_LIMIT)
+    {
+        _free(beginrel, dynseglen[i]);
+        _dynsegremove(i);
+        memsegments--;
+
+        // Dynamic segment has successfully been found and deleted
+        return;
+    }
+
+    // Attempt to free memory space that was not allocated
+    // There must be something wrong with the code if this happens
+    debug_print("memory.c | mem_free() | Pointer couldn't be freed because it wasn't found as allocated!");
+    debug_pause();
+
+    static const char PANIC_MESSAGE[] = "Cannot unallocate memory space that is not allocated!";
+    kernel_panic(PANIC_MESSAGE);
+}
+
+// Copy a specified amount of bytes from source to destination
+// Also safe for overlapping ranges as long as the destination begins before the source
+void mem_copy(const void* const ptrsrc, const void* const ptrdst, const size_t length)
+{
+    uint8_t* byteptrsrc = (uint8_t*)ptrsrc;
+    uint8_t* byteptrdst = (uint8_t*)ptrdst;
+    size_t i = 0;
+
+    if (length >= MEMORY_WORD_THRESHOLD)
+    {
+        // Copy single bytes until the destination is aligned
+        for (; (size_t)&byteptrdst[i] % sizeof(uint32_t); i++)
+        {
+            byteptrdst[i] = byteptrsrc[i];
+        }
+
+        // Copy the rest 4 bytes at a time
+        size_t words = (length - i) / sizeof(uint32_t);
+        rep_movsd(&byteptrdst[i], &byteptrsrc[i], words);
+        i += words * sizeof(uint32_t);
+    }
+
+    // Copy the remaining bytes
+    for (; i < length; i++)
+    {
+        byteptrdst[i] = byteptrsrc[i];
+    }
+}
+
+// Same as mem_copy() except the source and destination ranges may overlap in any way
+void mem_move(const void* const ptrsrc, const void* const ptrdst, const size_t length)
+{
+    uint8_t* byteptrsrc = (uint8_t*)ptrsrc;
+    uint8_t* byteptrdst = (uint8_t*)ptrdst;
+
+    // Copying from the beginning is safe unless the destination begins inside the source
+    if (byteptrdst <= byteptrsrc || byteptrdst >= byteptrsrc + length)
+    {
+        mem_copy(ptrsrc, ptrdst, length);
+        return;
+    }
+
+    // Copy from the end, so that the source bytes are read before they're overwritten
+    size_t i = length;
+
+    // Both pointers can only be aligned at the same time if they're a multiple of 4 bytes apart
+    if (length >= MEMORY_WORD_THRESHOLD && !((byteptrdst - byteptrsrc) % sizeof(uint32_t)))
+    {
+        for (; (size_t)&byteptrdst[i] % sizeof(uint32_t); i--)
+        {
+            byteptrdst[i - 1] = byteptrsrc[i - 1];
+        }
+
+        for (; i >= sizeof(uint32_t); i -= sizeof(uint32_t))
+        {
+            *(uint32_t*)&byteptrdst[i - sizeof(uint32_t)] = *(uint32_t*)&byteptrsrc[i - sizeof(uint32_t)];
+        }
+    }
+
+    for (; i > 0; i--)
+    {
+        byteptrdst[i - 1] = byteptrsrc[i - 1];
+    }
+}
+
+// Finds the smallest dynamic segment size with at least segsize bytes
+size_t _dynfindsize(const size_t segsize)
+{
+    // Even an empty segment occupies a single block
+    if (!segsize)
+        return DYNAMIC_SEGMENT_SIZE;
+
+    return _toblocks(segsize) * DYNAMIC_SEGMENT_SIZE;
+}
+
+// Allocates dynamic memory segment, used by mem_dynalloc() and mem_dynresize()
+void* _dynalloc(const size_t initsize)
+{
+    // Every branch either succeeds or panics
+    memsegments++;
+
+    // Small objects are allocated from slabs
+    if (initsize <= SLAB_OBJECT_SIZE_MAX)
+    {
+        return _slaballoc(_slabclass(initsize));
+    }
+
+    // Large objects are allocated from buddy blocks
+    if (initsize >= BUDDY_PAGE_SIZE && initsize <= BUDDY_BLOCK_SIZE_MAX)
+    {
+        void* buddyptr = _buddyalloc(_buddyorder(initsize));
+
+        if (buddyptr)
+        {
+            return buddyptr;
+        }
+
+        // No superblock is available, the object will be stored in a dynamic segment instead
+    }
+
+    size_t allocsize = _dynfindsize(initsize);
+    void* allocptr = _alloc(allocsize);
+    _dynsegstore(_toreladdressptr(allocptr), allocsize);
+    return allocptr;
+}
+
+// Returns the number of bytes that can be stored in an allocated dynamic segment
+// The segment can be used up to this size without resizing it
+size_t mem_dynsize(const void* const ptr)
+{
+    if (!_inmemoryptr(ptr))
+    {
+        debug_print("memory.c | mem_dynsize() | Pointer is outside of memory boundaries!");
+        debug_pause();
+
+        static const char PANIC_MESSAGE[] = "Unable to find specified memory segment!";
+        kernel_panic(PANIC_MESSAGE);
+        return 0;
+    }
+
+    size_t beginrel = _toreladdressptr(ptr);
+
+    if (_isregion(beginrel))
     {
-        // One of the bytes is already allocated
-        if (_getused(beginrel + i))
-            return false;
+        return ((struct REGION_OBJECT*)ptr - 1)->size;
     }
 
+    // Objects stored in slabs have the size of their size class
+    struct SLAB* slab = _slabfind(beginrel);
+    if (slab)
+    {
+        return DYNAMIC_SEGMENT_SIZE << (slab->sizeclass - 1);
+    }
+
+    if (_isbuddy(beginrel))
+    {
+        return BUDDY_PAGE_SIZE << (buddypages[beginrel / BUDDY_PAGE_SIZE] & BUDDY_PAGE_ORDER);
+    }
+
+    return _seglen(beginrel);
+}
+
+// Used when resizing dynamic memory segment
+// Returns true if all the bytes within specified range are unallocated
+bool _unallocated(const size_t beginrel, const size_t length)
+{
+    // Can't tell whether the memory is allocated or not if the
+    // requested range is outside availible memory's boundaries
+    if (beginrel + length >= memsize)
+    {
+        debug_print("memory.c | _unallocated() | Requested range is outside of memory boundaries!");
+        return false;
+    }
+
+    size_t block = beginrel / DYNAMIC_SEGMENT_SIZE;
+    size_t blocks = _toblocks(length);
+
+    // One of the bytes is already allocated
+    if (_scanused(block, block + blocks, true) != block + blocks)
+        return false;
+
     // All of the bytes within the requested range are unallocated
     return true;
 }
 
-// Resizes a dynamically allocated memory segment
-void* mem_dynresize(void* const ptr, const size_t newsize)
+// Resizes a dynamically allocated memory segment, used by mem_dynresize()
+void* _dynresize(void* const ptr, const size_t newsize)
 {
     if (!_inmemoryptr(ptr))
     {
-        debug_print("memory.c | mem_dynresize() | Pointer is outside of memory boundaries!");
+        debug_print("memory.c | _dynresize() | Pointer is outside of memory boundaries!");
         debug_pause();
 
         static const char PANIC_MESSAGE[] = "Cannot resize memory space outside the memory boundaries!";
@@ -411,75 +1376,173 @@ void* mem_dynresize(void* const ptr, const size_t newsize)
     }
 
     size_t beginrel = _toreladdressptr(ptr);
-    size_t newallocsize = _dynfindsize(newsize);
 
-    // Find the segment in dynamic segment storage
-    for (size_t i = 0; i < DYNAMIC_SEGMENT_LIMIT; i++)
+    // Region objects stay in the region that owns them
+    if (_isregion(beginrel))
     {
-        // Segment found
-        if (dynsegbegin[i] == beginrel)
+        struct REGION_OBJECT* obj = (struct REGION_OBJECT*)ptr - 1;
+        struct REGION_CHUNK* chunk = obj->chunk;
+
+        if (newsize <= obj->size)
+        {
+            return ptr;
+        }
+
+        // The last object of a chunk can grow over the rest of the chunk
+        size_t growth = ((newsize + REGION_OBJECT_ALIGN - 1) / REGION_OBJECT_ALIGN) * REGION_OBJECT_ALIGN - obj->size;
+
+        if ((size_t)ptr + obj->size == (size_t)chunk + chunk->used && chunk->size - chunk->used >= growth)
+        {
+            chunk->used += growth;
+            obj->size += growth;
+            return ptr;
+        }
+
+        // The old object is left behind until the region ends
+        void* newptr = _regionalloc(chunk->depth, newsize);
+        mem_copy(ptr, newptr, obj->size);
+        return newptr;
+    }
+
+    // Objects stored in slabs can't grow beyond the size of their size class
+    struct SLAB* slab = _slabfind(beginrel);
+    if (slab)
+    {
+        size_t objsize = DYNAMIC_SEGMENT_SIZE << (slab->sizeclass - 1);
+
+        // The new size still fits into the object
+        if (newsize <= objsize)
         {
-            // If the segment already has the size it's supposed to resize to
-            if (dynseglen[i] == newallocsize)
+            return ptr;
+        }
+
+        // Move the object to a bigger slab object / dynamic segment
+        void* newptr = _dynalloc(newsize);
+        mem_copy(ptr, newptr, objsize);
+        _slabfree(slab, ptr);
+        memsegments--;
+
+        return newptr;
+    }
+
+    // Buddy blocks are resized by halving them, by merging them with their free buddies or by moving them to a bigger block
+    if (_isbuddy(beginrel))
+    {
+        size_t order = buddypages[beginrel / BUDDY_PAGE_SIZE] & BUDDY_PAGE_ORDER;
+        size_t blocksize = BUDDY_PAGE_SIZE << order;
+
+        // The new size still fits into the block
+        if (newsize <= blocksize)
+        {
+            // Give back the upper halves that are no longer needed
+            while (order > 0 && newsize <= (size_t)(BUDDY_PAGE_SIZE << (order - 1)))
             {
-                // The old pointer can be returned without making any changes
-                return ptr;
+                order--;
+                buddypages[(beginrel + (BUDDY_PAGE_SIZE << order)) / BUDDY_PAGE_SIZE] = BUDDY_PAGE_USED | order;
+                _buddyfree(beginrel + (BUDDY_PAGE_SIZE << order));
             }
-            // If the allocated segment is longer than it's supposed to be
-            else if (dynseglen[i] > newallocsize)
+
+            buddypages[beginrel / BUDDY_PAGE_SIZE] = BUDDY_PAGE_USED | order;
+            return ptr;
+        }
+
+        // The block can grow in place if it's the lower half of each bigger block up to the new size
+        // and the upper halves are free as a whole
+        size_t neworder = _buddyorder(newsize);
+        size_t mergeorder = order;
+
+        while (mergeorder < neworder && neworder < BUDDY_ORDER_COUNT && !(beginrel & (BUDDY_PAGE_SIZE << mergeorder)) &&
+            buddypages[(beginrel + (BUDDY_PAGE_SIZE << mergeorder)) / BUDDY_PAGE_SIZE] == (BUDDY_PAGE_FREE | mergeorder))
+        {
+            mergeorder++;
+        }
+
+        if (mergeorder == neworder)
+        {
+            for (; order < neworder; order++)
+            {
+                _buddyunlink(beginrel + (BUDDY_PAGE_SIZE << order), order);
+                memallocated += BUDDY_PAGE_SIZE << order;
+            }
+
+            buddypages[beginrel / BUDDY_PAGE_SIZE] = BUDDY_PAGE_USED | order;
+            return ptr;
+        }
+
+        // Move the object to a bigger buddy block / dynamic segment
+        void* newptr = _dynalloc(newsize);
+        mem_copy(ptr, newptr, blocksize);
+        _buddyfree(beginrel);
+        memsegments--;
+
+        return newptr;
+    }
+
+    size_t newallocsize = _dynfindsize(newsize);
+
+    // Find the segment in dynamic segment storage
+    size_t i = _dynsegfind(beginrel);
+
+    // Segment found
+    if (i < DYNAMIC_SEGMENT_LIMIT)
+    {
+        // If the segment already has the size it's supposed to resize to
+        if (dynseglen[i] == newallocsize)
+        {
+            // The old pointer can be returned without making any changes
+            return ptr;
+        }
+        // If the allocated segment is longer than it's supposed to be
+        else if (dynseglen[i] > newallocsize)
+        {
+            // Calculate the length difference between the old segment length and the new one
+            size_t lendiff = dynseglen[i] - newallocsize;
+            // Unallocate the no longer needed part of the dynamic segment
+            _free(beginrel + dynseglen[i] - lendiff, lendiff);
+            // Store the new segment length
+            dynseglen[i] = newallocsize;
+            memallocated -= lendiff;
+            // The original pointer is returned because the segment hasn't moved
+            return ptr;
+        }
+        // The resized segment is supposed to be longer than it currently is
+        else if (dynseglen[i] < newallocsize)
+        {
+            size_t lendiff = newallocsize - dynseglen[i];
+
+            // If there are enough unallocated bytes after the already allocated segment
+            if (_unallocated(beginrel + dynseglen[i], lendiff))
             {
-                // Calculate the length difference between the old segment length and the new one
-                size_t lendiff = dynseglen[i] - newallocsize;
-                // Unallocate the no longer needed part of the dynamic segment
-                _free(beginrel + dynseglen[i] - lendiff, lendiff);
+                // The segment will simply be prolonged and additional bytes will be allocated
+                _setused((beginrel + dynseglen[i]) / DYNAMIC_SEGMENT_SIZE, _toblocks(lendiff), true);
+
                 // Store the new segment length
                 dynseglen[i] = newallocsize;
-                // The original pointer is returned because the segment hasn't moved
+                memallocated += lendiff;
+
+                // The original pointer can be returned because the segment hasn't moved
                 return ptr;
             }
-            // The resized segment is supposed to be longer than it currently is
-            else if (dynseglen[i] < newallocsize)
+            else
             {
-                size_t lendiff = newallocsize - dynseglen[i];
-
-                // If there are enough unallocated bytes after the already allocated segment
-                if (_unallocated(beginrel + dynseglen[i], lendiff))
-                {
-                    // The segment will simply be prolonged and additional bytes will be allocated
-                    for (size_t j = 0; j < lendiff; j++)
-                    {
-                        _setused(beginrel + dynseglen[i] + j, true);
-                    }
-
-                    // Store the new segment length
-                    dynseglen[i] = newallocsize;
-
-                    // The original pointer can be returned because the segment hasn't moved
-                    return ptr;
-                }
-                else
-                {
-                    // Copies data from the old segment to a new place in the memory
-                    // that has enough unallocated bytes to fit the new size of the segment
-                    void* newptr = _copy(ptr, newallocsize);
-                    // Unallocate bytes that used to belong to this segment
-                    _free(beginrel, dynseglen[i]);
-
-                    // Get the new relative memory address
-                    size_t newbeginrel = _toreladdressptr(newptr);
-
-                    // Store the new information about the segment
-                    dynsegbegin[i] = newbeginrel;
-                    dynseglen[i] = newallocsize;
-
-                    // Return the new pointer because the segment has moved
-                    return newptr;
-                }
+                // Copies data from the old segment to a new place in the memory
+                // that has enough unallocated bytes to fit the new size of the segment
+                // Large segments may end up in a buddy block this way
+                void* newptr = _dynalloc(newsize);
+                mem_copy(ptr, newptr, dynseglen[i]);
+
+                // Unallocate bytes that used to belong to this segment
+                _free(beginrel, dynseglen[i]);
+                _dynsegremove(i);
+                memsegments--;
+
+                // Return the new pointer because the segment has moved
+                return newptr;
             }
         }
     }
 
-    debug_print("memory.c | mem_dynresize() | Failed to resize a dynamic memory segment!");
+    debug_print("memory.c | _dynresize() | Failed to resize a dynamic memory segment!");
     debug_pause();
 
     static const char PANIC_MESSAGE[] = "Failed to resize the memory space!";
@@ -487,11 +1550,120 @@ void* mem_dynresize(void* const ptr, const size_t newsize)
     return (void*)0;
 }
 
+void* mem_dynalloc(const size_t initsize)
+{
+    return mem_tracedalloc(initsize, __builtin_return_address(0));
+}
+
+void* mem_tracedalloc(const size_t initsize, const void* const caller)
+{
+    void* ptr = _dynalloc(initsize);
+    memprof_alloc(ptr, initsize, caller);
+    return ptr;
+}
+
+void* mem_dynresize(void* const ptr, const size_t newsize)
+{
+    return mem_tracedresize(ptr, newsize, __builtin_return_address(0));
+}
+
+void* mem_tracedresize(void* const ptr, const size_t newsize, const void* const caller)
+{
+    void* newptr = _dynresize(ptr, newsize);
+    memprof_resize(ptr, newptr, newsize, caller);
+    return newptr;
+}
+
+// Allocates memory beginning at a multiple of align bytes, used by mem_alignalloc() and mem_dmaalloc()
+void* _alignalloc(const size_t size, const size_t align, const void* const caller)
+{
+    if (!align || (align & (align - 1)))
+    {
+        debug_print("memory.c | _alignalloc() | Alignment must be a power of two!");
+        debug_pause();
+
+        static const char PANIC_MESSAGE[] = "Cannot allocate memory space with invalid alignment!";
+        kernel_panic(PANIC_MESSAGE);
+        return (void*)0;
+    }
+
+    // Every allocation is aligned to the size of a block
+    if (align <= DYNAMIC_SEGMENT_SIZE)
+    {
+        return mem_tracedalloc(size, caller);
+    }
+
+    void* ptr = (void*)0;
+
+    // Slab objects are aligned to their size, so an object at least as big as the alignment will do
+    if (size <= SLAB_OBJECT_SIZE_MAX && align <= SLAB_OBJECT_SIZE_MAX)
+    {
+        ptr = _slaballoc(_slabclass(size > align ? size : align));
+    }
+    else
+    {
+        // Otherwise a dynamic segment is placed at an aligned absolute address
+        size_t allocsize = _dynfindsize(size);
+        size_t alignblocks = align / DYNAMIC_SEGMENT_SIZE;
+        size_t skew = (memstartbyte / DYNAMIC_SEGMENT_SIZE) % alignblocks;
+
+        ptr = (void*)(memstartbyte + _allocblocks(_toblocks(allocsize), alignblocks, skew) * DYNAMIC_SEGMENT_SIZE);
+        _dynsegstore(_toreladdressptr(ptr), allocsize);
+    }
+
+    memsegments++;
+    memprof_alloc(ptr, size, caller);
+    return ptr;
+}
+
+void* mem_alignalloc(const size_t size, const size_t align)
+{
+    return _alignalloc(size, align, __builtin_return_address(0));
+}
+
+void* mem_dmaalloc(const size_t size, const size_t boundary)
+{
+    // Word alignment is required by both IDE and AHCI physical region descriptors
+    size_t align = sizeof(uint32_t);
+
+    // An object that is aligned to its size rounded up to a power of two doesn't cross any bigger boundary
+    // Bigger objects are aligned to the boundary, so that each boundary-sized piece of them stays within one window
+    if (boundary)
+    {
+        while (align < size && align < boundary)
+            align <<= 1;
+    }
+
+    return _alignalloc(size, align, __builtin_return_address(0));
+}
+
+size_t mem_physaddr(const void* const ptr)
+{
+    // Paging is never enabled, so the memory is identity mapped
+    return (size_t)ptr;
+}
+
 void* mem_set(void* ptr, int value, size_t num)
 {
     unsigned char* dst = (unsigned char*)ptr;
     unsigned char cval = (unsigned char)value;
 
+    if (num >= MEMORY_WORD_THRESHOLD)
+    {
+        // Fill single bytes until the destination is aligned
+        for (; (size_t)dst % sizeof(uint32_t); num--)
+        {
+            *dst = cval;
+            dst++;
+        }
+
+        // Fill the rest 4 bytes at a time, each of them holding the value
+        size_t words = num / sizeof(uint32_t);
+        rep_stosd(dst, (uint32_t)cval * 0x01010101u, words);
+        dst += words * sizeof(uint32_t);
+        num -= words * sizeof(uint32_t);
+    }
+
     while (num-- > 0)
     {
         *dst = cval;
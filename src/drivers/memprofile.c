@@ -0,0 +1,290 @@
+#include <drivers/memprofile.h>
+#include <drivers/memory.h>
+#include <kernel.h>
+#include <assembly.h>
+
+// The code inside memprof_*() functions that record allocations is only executed in DEBUG mode
+
+#ifdef DEBUG
+
+#define MEMPROF_SITE_LIMIT 0x400 // maximum number of call sites, must be a power of 2
+#define MEMPROF_OBJECT_LIMIT 0x10000 // maximum number of live objects tracked at once, must be a power of 2
+// Returned instead of a slot index when there is no such slot
+#define MEMPROF_NONE ((size_t)-1)
+
+// A single live object tracked by the profiler
+struct MEMPROF_OBJECT
+{
+    const void* ptr; // pointer returned by the allocator, nullptr means the slot is empty
+    size_t size; // requested size of the object
+    uint64_t time; // time stamp of the allocation
+    size_t site; // slot of the call site that allocated the object
+};
+
+// Call sites and live objects are stored in open-addressed hash tables keyed by their address
+static struct MEMPROF_SITE memprofsites[MEMPROF_SITE_LIMIT];
+static size_t memprofsitecount = 0;
+
+static struct MEMPROF_OBJECT memprofobjects[MEMPROF_OBJECT_LIMIT];
+static size_t memprofobjectcount = 0;
+
+static size_t memprofuntracked = 0;
+static size_t memprofbuckets[MEMPROF_BUCKET_COUNT];
+
+// Fibonacci hashing spreads neighbouring addresses across the whole table
+static inline size_t _memprofhash(const void* const ptr, const size_t limit)
+{
+    return (((uint32_t)((size_t)ptr >> 2)) * 0x9E3779B1) >> (32 - __builtin_ctz(limit));
+}
+
+// Returns the size bucket of an allocation
+static inline size_t _memprofbucket(const size_t size)
+{
+    return (size ? 32 - __builtin_clz(size) : 0);
+}
+
+// Finds the slot of a call site, creates it if it doesn't exist yet
+// Returns MEMPROF_NONE if there is no space for another call site
+size_t _memprofsite(const void* const caller)
+{
+    size_t i = _memprofhash(caller, MEMPROF_SITE_LIMIT);
+
+    for (; memprofsites[i].caller; i = (i + 1) % MEMPROF_SITE_LIMIT)
+    {
+        if (memprofsites[i].caller == caller)
+        {
+            return i;
+        }
+    }
+
+    // There must always be at least one empty slot, otherwise lookups would never end
+    if (memprofsitecount + 1 >= MEMPROF_SITE_LIMIT)
+    {
+        return MEMPROF_NONE;
+    }
+
+    memprofsites[i].caller = caller;
+    memprofsitecount++;
+    return i;
+}
+
+// Finds the slot of a live object, returns MEMPROF_NONE if the object isn't tracked
+size_t _memprofobject(const void* const ptr)
+{
+    for (size_t i = _memprofhash(ptr, MEMPROF_OBJECT_LIMIT); memprofobjects[i].ptr; i = (i + 1) % MEMPROF_OBJECT_LIMIT)
+    {
+        if (memprofobjects[i].ptr == ptr)
+        {
+            return i;
+        }
+    }
+
+    return MEMPROF_NONE;
+}
+
+// Starts tracking a live object, the caller must make sure there is an empty slot
+void _memprofinsert(const struct MEMPROF_OBJECT* const object)
+{
+    size_t i = _memprofhash(object->ptr, MEMPROF_OBJECT_LIMIT);
+
+    while (memprofobjects[i].ptr)
+    {
+        i = (i + 1) % MEMPROF_OBJECT_LIMIT;
+    }
+
+    memprofobjects[i] = *object;
+    memprofobjectcount++;
+}
+
+// Stops tracking a live object
+void _memprofremove(size_t slot)
+{
+    // Objects following the removed one are shifted back to fill the gap,
+    // so that none of them becomes unreachable from the slot its hash points to
+    for (size_t i = (slot + 1) % MEMPROF_OBJECT_LIMIT; memprofobjects[i].ptr; i = (i + 1) % MEMPROF_OBJECT_LIMIT)
+    {
+        size_t home = _memprofhash(memprofobjects[i].ptr, MEMPROF_OBJECT_LIMIT);
+
+        if (((i - home) % MEMPROF_OBJECT_LIMIT) >= ((i - slot) % MEMPROF_OBJECT_LIMIT))
+        {
+            memprofobjects[slot] = memprofobjects[i];
+            slot = i;
+        }
+    }
+
+    memprofobjects[slot].ptr = (const void*)0;
+    memprofobjectcount--;
+}
+
+#endif
+
+#ifndef DEBUG
+    #pragma GCC diagnostic push
+    #pragma GCC diagnostic ignored "-Wunused-parameter"
+#endif
+void memprof_alloc(const void* const ptr, const size_t size, const void* const caller)
+{
+    #ifdef DEBUG
+
+    memprofbuckets[_memprofbucket(size)]++;
+
+    size_t site = (memprofobjectcount + 1 < MEMPROF_OBJECT_LIMIT ? _memprofsite(caller) : MEMPROF_NONE);
+
+    // The profiler is full, the object can't be attributed to its call site
+    if (site == MEMPROF_NONE)
+    {
+        memprofuntracked++;
+        return;
+    }
+
+    memprofsites[site].allocs++;
+    memprofsites[site].livebytes += size;
+    memprofsites[site].totalbytes += size;
+
+    struct MEMPROF_OBJECT object = { ptr, size, rdtsc(), site };
+    _memprofinsert(&object);
+
+    #endif
+}
+
+void memprof_resize(const void* const oldptr, const void* const newptr, const size_t newsize, const void* const caller)
+{
+    #ifdef DEBUG
+
+    size_t site = _memprofsite(caller);
+
+    if (site != MEMPROF_NONE)
+    {
+        memprofsites[site].resizes++;
+    }
+
+    size_t slot = _memprofobject(oldptr);
+
+    if (slot == MEMPROF_NONE)
+    {
+        return;
+    }
+
+    // The object still belongs to the call site that allocated it
+    struct MEMPROF_OBJECT object = memprofobjects[slot];
+    memprofsites[object.site].livebytes += newsize - object.size;
+    object.size = newsize;
+
+    if (newptr == oldptr)
+    {
+        memprofobjects[slot] = object;
+        return;
+    }
+
+    // The object has moved, so it must be stored under its new address
+    _memprofremove(slot);
+    object.ptr = newptr;
+    _memprofinsert(&object);
+
+    #endif
+}
+
+void memprof_free(const void* const ptr)
+{
+    #ifdef DEBUG
+
+    size_t slot = _memprofobject(ptr);
+
+    if (slot == MEMPROF_NONE)
+    {
+        return;
+    }
+
+    struct MEMPROF_SITE* site = &memprofsites[memprofobjects[slot].site];
+    site->frees++;
+    site->livebytes -= memprofobjects[slot].size;
+    site->lifetime += rdtsc() - memprofobjects[slot].time;
+
+    _memprofremove(slot);
+
+    #endif
+}
+
+size_t memprof_top(struct MEMPROF_SITE* const sites, const size_t count)
+{
+    size_t found = 0;
+
+    #ifdef DEBUG
+
+    // Insert each call site into the sorted output, the site with the fewest allocations falls out
+    for (size_t i = 0; i < MEMPROF_SITE_LIMIT; i++)
+    {
+        if (!memprofsites[i].caller)
+        {
+            continue;
+        }
+
+        size_t pos = found;
+
+        while (pos > 0 && sites[pos - 1].allocs < memprofsites[i].allocs)
+        {
+            if (pos < count)
+            {
+                sites[pos] = sites[pos - 1];
+            }
+
+            pos--;
+        }
+
+        if (pos < count)
+        {
+            sites[pos] = memprofsites[i];
+
+            if (found < count)
+            {
+                found++;
+            }
+        }
+    }
+
+    #endif
+
+    return found;
+}
+
+void memprof_histogram(size_t* const buckets)
+{
+    for (size_t i = 0; i < MEMPROF_BUCKET_COUNT; i++)
+    {
+        #ifdef DEBUG
+        buckets[i] = memprofbuckets[i];
+        #else
+        buckets[i] = 0;
+        #endif
+    }
+}
+#ifndef DEBUG
+    #pragma GCC diagnostic pop
+#endif
+
+bool memprof_enabled(void)
+{
+    #ifdef DEBUG
+    return true;
+    #else
+    return false;
+    #endif
+}
+
+size_t memprof_live(void)
+{
+    #ifdef DEBUG
+    return memprofobjectcount;
+    #else
+    return 0;
+    #endif
+}
+
+size_t memprof_untracked(void)
+{
+    #ifdef DEBUG
+    return memprofuntracked;
+    #else
+    return 0;
+    #endif
+}
@@ -2,20 +2,95 @@
 #include <assembly.h>
 #include <drivers/memory.h>
 
+// PCI configuration space access ports
+const uint16_t PCI_CONFIG_ADDRESS = 0xCF8;
+const uint16_t PCI_CONFIG_DATA    = 0xCFC;
+
+// Offset of the command and status registers in the configuration space
+const uint8_t PCI_OFFSET_COMMAND = 0x04;
+
+uint32_t pciConfigAddress(const uint8_t bus, const uint8_t slot, const uint8_t func, const uint8_t offset)
+{
+    uint32_t address = 0x80000000 | (offset & 0xfc);
+    address  |= ((uint32_t)bus) << 16;
+    address  |= ((uint32_t)slot) << 11;
+    address  |= ((uint32_t)func) << 8;
+
+    return address;
+}
+
+uint32_t pciConfigRead(const uint8_t bus, const uint8_t slot, const uint8_t func, const uint8_t offset)
+{
+    outl(PCI_CONFIG_ADDRESS, pciConfigAddress(bus, slot, func, offset));
+    return inl(PCI_CONFIG_DATA);
+}
+
+void pciConfigWrite(const uint8_t bus, const uint8_t slot, const uint8_t func, const uint8_t offset, const uint32_t value)
+{
+    outl(PCI_CONFIG_ADDRESS, pciConfigAddress(bus, slot, func, offset));
+    outl(PCI_CONFIG_DATA, value);
+}
+
 struct pcidevice* getPciDevice(const uint8_t bus, const uint8_t slot, const uint8_t func)
 {
     uint32_t* devptr = (uint32_t*)mem_dynalloc(sizeof(struct pcidevice));
 
-    for (size_t i = 0; i < sizeof(struct pcidevice); i++)
+    // The configuration space is read by 4 byte registers
+    for (size_t i = 0; i < sizeof(struct pcidevice) / sizeof(uint32_t); i++)
     {
-        uint32_t address = 0x80000000 | ((i << 2) & 0xfc);
-        address  |= ((uint32_t)bus) << 16;
-        address  |= ((uint32_t)slot) << 11;
-        address  |= ((uint32_t)func) << 8;
-
-        outl(0xCF8, address);
-        devptr[i] = inl(0xCFC);
+        devptr[i] = pciConfigRead(bus, slot, func, i << 2);
     }
 
     return (struct pcidevice*)devptr;
 }
+
+bool findPciDevice(const uint8_t classid, const uint8_t subclass, uint8_t* const busptr, uint8_t* const slotptr, uint8_t* const funcptr)
+{
+    for (uint8_t ibus = 0; ibus < 8; ibus++)
+    {
+        for (uint8_t islot = 0; islot < 32; islot++)
+        {
+            for (uint8_t ifunc = 0; ifunc < 8; ifunc++)
+            {
+                uint32_t ids = pciConfigRead(ibus, islot, ifunc, 0x00);
+
+                // No device present
+                if ((uint16_t)ids == 0xFFFF)
+                {
+                    // Functions of a device don't have to be numbered continuously, but function 0 must always exist
+                    if (ifunc == 0)
+                    {
+                        break;
+                    }
+
+                    continue;
+                }
+
+                uint32_t classreg = pciConfigRead(ibus, islot, ifunc, 0x08);
+
+                if ((uint8_t)(classreg >> 24) == classid && (uint8_t)(classreg >> 16) == subclass)
+                {
+                    *busptr = ibus;
+                    *slotptr = islot;
+                    *funcptr = ifunc;
+                    return true;
+                }
+
+                // Only multi-function devices have other functions than 0
+                if (ifunc == 0 && !(pciConfigRead(ibus, islot, ifunc, 0x0C) & 0x800000))
+                {
+                    break;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+void pciEnableBusMaster(const uint8_t bus, const uint8_t slot, const uint8_t func)
+{
+    // Bits 0 and 1 enable I/O and memory space access, bit 2 allows the device to access memory on its own
+    uint32_t command = pciConfigRead(bus, slot, func, PCI_OFFSET_COMMAND);
+    pciConfigWrite(bus, slot, func, PCI_OFFSET_COMMAND, (command & 0xFFFF) | 0x7);
+}
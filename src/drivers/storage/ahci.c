@@ -4,6 +4,8 @@
 #include <drivers/io/terminal.h>
 #include <c/string.h>
 #include <drivers/storage/harddrive.h>
+#include <drivers/pci.h>
+#include <drivers/timer.h>
 #include <kernel.h>
 
 // Detect attached SATA devices
@@ -57,46 +59,6 @@ void trace_ahci(const char* const str, const int num)
     term_writeline_convert((size_t)num, 10);
 }
  
-void probe_port(HBA_MEM *abar)
-{
-	// Search disk in impelemented ports
-	DWORD pi = abar->pi;
-
-	for (size_t i = 0; i < 32; i++)
-	{
-		if (pi & 1)
-		{
-			int dt = check_type(&abar->ports[i]);
-
-			if (dt == AHCI_DEV_SATA)
-			{
-				trace_ahci("SATA drive found at port ", i);
-
-				// Store the SATA drive in the HDD array
-				hddAddAHCI(&abar->ports[i]);
-			}
-			else if (dt == (int)AHCI_DEV_SATAPI)
-			{
-				trace_ahci("SATAPI drive found at port ", i);
-			}
-			else if (dt == (int)AHCI_DEV_SEMB)
-			{
-				trace_ahci("SEMB drive found at port ", i);
-			}
-			else if (dt == (int)AHCI_DEV_PM)
-			{
-				trace_ahci("PM drive found at port ", i);
-			}
-			else
-			{
-				//trace_ahci("No drive found at port ", i);
-			}
-		}
- 
-		pi >>= 1;
-	}
-}
-
 // AHCI port memory space initialization
 /* BIOS may have already configured all the necessary AHCI memory spaces.
 But the OS usually needs to reconfigure them to make them fit its requirements.
@@ -107,15 +69,27 @@ and tell HBA to stop receiving FIS from the port. Otherwise an accidently incomi
 may be written into a partially configured memory area. This is done by checking and
 setting corresponding bits at the Port Command And Status register (HBA_PORT.cmd).
 The example subroutines stop_cmd() and start_cmd() do the job.
-The following example assumes that the HBA has 32 ports implemented and each port
-contains 32 command slots, and will allocate 8 PRDTs for each command slot. */
-#define	AHCI_BASE	0x400000	// 4M
+Each port contains 32 command slots and 8 PRDTs are allocated for each command slot.
+The memory spaces are allocated from the heap, so that they can't collide with anything else. */
+#define AHCI_CMD_LIST_SIZE 0x400 // 32 command headers, 1K aligned
+#define AHCI_FIS_SIZE 0x100 // 256 bytes aligned
+#define AHCI_CMD_TBL_SIZE 0x100 // 256 bytes per command table with 8 PRDTs, 128 bytes aligned
+#define AHCI_CMD_TBL_ALIGN 0x80
+#define AHCI_TIMEOUT_MS 3000 // longest time a port may take to respond before it's considered hung
  
+// Waits until none of the bits are set in the port's command register, gives up after AHCI_TIMEOUT_MS
+void await_cmd(HBA_PORT *port, const DWORD bits)
+{
+	uint64_t deadline = timer_ms() + AHCI_TIMEOUT_MS;
+
+	while ((port->cmd & bits) && timer_ms() < deadline);
+}
+
 // Start command engine
 void start_cmd(HBA_PORT *port)
 {
 	// Wait until CR (bit15) is cleared
-	while (port->cmd & HBA_PxCMD_CR);
+	await_cmd(port, HBA_PxCMD_CR);
  
 	// Set FRE (bit4) and ST (bit0)
 	port->cmd |= HBA_PxCMD_FRE;
@@ -128,161 +102,386 @@ void stop_cmd(HBA_PORT *port)
 	// Clear ST (bit0)
 	port->cmd &= ~HBA_PxCMD_ST;
  
-	// Wait until FR (bit14), CR (bit15) are cleared
-	//while(port->cmd & HBA_PxCMD_FR || port->cmd & HBA_PxCMD_CR);
+	// Wait until CR (bit15) is cleared
+	await_cmd(port, HBA_PxCMD_CR);
  
-	// Clear FRE (bit4)
+	// Clear FRE (bit4) and wait until FR (bit14) is cleared
 	port->cmd &= ~HBA_PxCMD_FRE;
+	await_cmd(port, HBA_PxCMD_FR);
 }
  
-void port_rebase(HBA_PORT *port, int portno)
+void port_rebase(HBA_PORT *port)
 {
 	stop_cmd(port);	// Stop command engine	
 
-	// Command list offset: 1K*portno
 	// Command list entry size = 32
 	// Command list entry maxim count = 32
 	// Command list maxim size = 32*32 = 1K per port
-	port->clb = AHCI_BASE + (portno<<10);
+	void* cmdlist = mem_alignalloc(AHCI_CMD_LIST_SIZE, AHCI_CMD_LIST_SIZE);
+	mem_set(cmdlist, 0, AHCI_CMD_LIST_SIZE);
+	port->clb = mem_physaddr(cmdlist);
 	port->clbu = 0;
-	mem_set((void*)port->clb, 0, 1024);
 
-	// FIS offset: 32K+256*portno
 	// FIS entry size = 256 bytes per port
-	port->fb = AHCI_BASE + (32<<10) + (portno<<8);
+	void* fis = mem_alignalloc(AHCI_FIS_SIZE, AHCI_FIS_SIZE);
+	mem_set(fis, 0, AHCI_FIS_SIZE);
+	port->fb = mem_physaddr(fis);
 	port->fbu = 0;
-	mem_set((void*)port->fb, 0, 256);
  
-	// Command table offset: 40K + 8K*portno
 	// Command table size = 256*32 = 8K per port
-	HBA_CMD_HEADER *cmdheader = (HBA_CMD_HEADER*)port->clb;
+	uint8_t* cmdtables = (uint8_t*)mem_alignalloc(AHCI_CMD_TBL_SIZE * 32, AHCI_CMD_TBL_ALIGN);
+	mem_set(cmdtables, 0, AHCI_CMD_TBL_SIZE * 32);
+
+	HBA_CMD_HEADER *cmdheader = (HBA_CMD_HEADER*)cmdlist;
 	for (int i=0; i<32; i++)
 	{
 		cmdheader[i].prdtl = 8;	// 8 prdt entries per command table
 					// 256 bytes per command table, 64+16+48+16*8
-		// Command table offset: 40K + 8K*portno + cmdheader_index*256
-		cmdheader[i].ctba = AHCI_BASE + (40<<10) + (portno<<13) + (i<<8);
+		cmdheader[i].ctba = mem_physaddr(&cmdtables[i * AHCI_CMD_TBL_SIZE]);
 		cmdheader[i].ctbau = 0;
-		mem_set((void*)cmdheader[i].ctba, 0, 256);
 	}
  
 	start_cmd(port);	// Start command engine
 }
 
-// Example - Read hard disk sectors
-/* The code example shows how to read "count" sectors from sector offset "starth:startl"
-to "buf" with LBA48 mode from HBA "port". Every PRDT entry contains 8K bytes data payload at most. */
+// Reading and writing hard disk sectors
+/* Large transfers are split into several commands, which are issued into free command slots
+all at once, so that the drive always has the next command at hand. Drives that support
+Native Command Queuing get READ / WRITE FPDMA QUEUED commands, which they may complete in any order.
+Every command has a single PRDT entry, the buffers are physically contiguous. */
 #define ATA_DEV_BUSY 0x80
 #define ATA_DEV_DRQ 0x08
- 
-// Find a free command list slot
-int find_cmdslot(HBA_PORT *port)
+
+#define AHCI_CHUNK_SECTORS 0x100 // sectors per command, more commands can then be in flight at once
+
+// State of each SATA drive, indexed by its port number
+struct AHCI_DEVICE
 {
-	// If not set in SACT and CI, the slot is free
-	DWORD slots = (port->sact | port->ci);
+	HBA_PORT* port;
+	DWORD slots; // mask of command slots the drive may use
+	bool ncq;    // the drive supports Native Command Queuing
+};
 
-	for (int i = 0; i < 32; i++)
+static struct AHCI_DEVICE ahciDevices[32];
+static size_t ahciDeviceCount = 0;
+// Number of command slots supported by the controller and whether it supports NCQ
+static DWORD ahciSlots = 1;
+static bool ahciNcq = false;
+
+struct AHCI_DEVICE* ahci_device(const HBA_PORT* const port)
+{
+	for (size_t i = 0; i < ahciDeviceCount; i++)
 	{
-		if ((slots & 1) == 0)
+		if (ahciDevices[i].port == port)
 		{
-			return i;
+			return &ahciDevices[i];
 		}
-
-		slots >>= 1;
 	}
 
-	debug_print("ahci.c | find_cmdslot() | Cannot find free command list entry");
-	return -1;
+	return (struct AHCI_DEVICE*)0;
 }
- 
-BOOL ahci_read(HBA_PORT *port, QWORD start, DWORD count, WORD *buf)
+
+// Find a free command list slot
+int find_cmdslot(const struct AHCI_DEVICE* const dev)
 {
-	port->is = (DWORD)-1; // Clear pending interrupt bits
-	int spin = 0; // Spin lock timeout counter
-	int cmdslot = find_cmdslot(port);
-	if (cmdslot == -1)
+	// If not set in SACT and CI, the slot is free
+	DWORD slots = (dev->port->sact | dev->port->ci) | ~dev->slots;
+
+	if (slots == (DWORD)-1)
 	{
-		return FALSE;
+		return -1;
 	}
- 
-	HBA_CMD_HEADER *cmdheader = (HBA_CMD_HEADER*)port->clb;
+
+	return __builtin_ctz(~slots);
+}
+
+// Fills the command slot with a command transferring count sectors between the drive and buf
+void ahci_setup(const struct AHCI_DEVICE* const dev, const int cmdslot, const BYTE command, const QWORD start, const DWORD count, const DWORD bytes, void* const buf, const bool write)
+{
+	HBA_CMD_HEADER *cmdheader = (HBA_CMD_HEADER*)dev->port->clb;
 	cmdheader += cmdslot;
 	cmdheader->cfl = sizeof(FIS_REG_H2D)/sizeof(DWORD);	// Command FIS size
-	cmdheader->w = 0;		// Read from device
-	cmdheader->prdtl = (WORD)((count-1)>>4) + 1;	// PRDT entries count
- 
+	cmdheader->w = write;
+	cmdheader->prdtl = 1;
+	cmdheader->prdbc = 0;
+
 	HBA_CMD_TBL *cmdtbl = (HBA_CMD_TBL*)cmdheader->ctba;
-	mem_set(cmdtbl, 0, sizeof(HBA_CMD_TBL) + (cmdheader->prdtl-1)*sizeof(HBA_PRDT_ENTRY));
- 
-	// 8K bytes (16 sectors) per PRDT
-	for (int i = 0; i < cmdheader->prdtl-1; i++)	
-	{
-		cmdtbl->prdt_entry[i].dba = (DWORD)buf;
-		cmdtbl->prdt_entry[i].dbau = 0;
-		cmdtbl->prdt_entry[i].dbc = 1<<13; // 8K bytes
-		cmdtbl->prdt_entry[i].i = 1;
-		buf += 1<<13; // 4K words
-		count -= 16; // 16 sectors
-	}
+	mem_set(cmdtbl, 0, sizeof(HBA_CMD_TBL));
+
+	// A PRDT entry can describe up to 4M bytes, the byte count is stored minus one
+	cmdtbl->prdt_entry[0].dba = mem_physaddr(buf);
+	cmdtbl->prdt_entry[0].dbau = 0;
+	cmdtbl->prdt_entry[0].dbc = bytes - 1;
+	cmdtbl->prdt_entry[0].i = 1;
 
-	// Last entry
-	cmdtbl->prdt_entry[cmdheader->prdtl-1].dba = (DWORD)buf;
-	cmdtbl->prdt_entry[cmdheader->prdtl-1].dbau = 0;
-	cmdtbl->prdt_entry[cmdheader->prdtl-1].dbc = count<<9;	// 512 bytes per sector
-	cmdtbl->prdt_entry[cmdheader->prdtl-1].i = 1;
- 
 	// Setup command
 	FIS_REG_H2D *cmdfis = (FIS_REG_H2D*)&cmdtbl->cfis;
- 
+
 	cmdfis->fis_type = FIS_TYPE_REG_H2D;
 	cmdfis->c = 1; // Command
-	cmdfis->command = ATA_CMD_READ_DMA_EX;
- 
+	cmdfis->command = command;
+
 	cmdfis->lba0 = (BYTE)start;
 	cmdfis->lba1 = (BYTE)(start>>8);
 	cmdfis->lba2 = (BYTE)(start>>16);
 	cmdfis->device = 1<<6; // LBA mode
- 
+
 	cmdfis->lba3 = (BYTE)(start>>24);
 	cmdfis->lba4 = (BYTE)(start>>32);
 	cmdfis->lba5 = (BYTE)(start>>40);
- 
-    cmdfis->countl = (BYTE)count;
-	cmdfis->counth = (BYTE)(count>>8);
- 
-	// The below loop waits until the port is no longer busy before issuing a new command
-	while ((port->tfd & (ATA_DEV_BUSY | ATA_DEV_DRQ)) && spin < 1000000)
+
+	if (command == ATA_CMD_READ_FPDMA_QUEUED || command == ATA_CMD_WRITE_FPDMA_QUEUED)
 	{
-		spin++;
+		// Queued commands carry the sector count in the feature register and the slot number (tag) in the count register
+		cmdfis->featurel = (BYTE)count;
+		cmdfis->featureh = (BYTE)(count>>8);
+		cmdfis->countl = (BYTE)(cmdslot<<3);
 	}
-	if (spin == 1000000)
+	else
 	{
-		debug_print("ahci.c | ahci_read() | Port is hung");
-		return FALSE;
+		cmdfis->countl = (BYTE)count;
+		cmdfis->counth = (BYTE)(count>>8);
 	}
- 
-	port->ci = 1<<cmdslot; // Issue command
- 
-	// Wait for completion
-	while (1)
+}
+
+// Restarts the command engine to get the port out of an error state
+void ahci_recover(HBA_PORT *port)
+{
+	stop_cmd(port);
+	port->serr = (DWORD)-1;
+	port->is = (DWORD)-1;
+	start_cmd(port);
+}
+
+// Waits until none of the slots in the mask are in use, returns false on error or timeout
+BOOL ahci_wait(HBA_PORT *port, const DWORD mask)
+{
+	uint64_t deadline = timer_ms() + AHCI_TIMEOUT_MS;
+
+	while ((port->sact | port->ci) & mask)
 	{
-		// In some longer duration reads, it may be helpful to spin on the DPS bit 
-		// in the PxIS port field as well (1 << 5)
-		if ((port->ci & (1<<cmdslot)) == 0) 
-			break;
 		if (port->is & HBA_PxIS_TFES)	// Task file error
 		{
-			debug_print("ahci.c | ahci_read() | Read disk error");
+			debug_print("ahci.c | ahci_wait() | Disk error");
+			ahci_recover(port);
+			return FALSE;
+		}
+
+		if (timer_ms() >= deadline)
+		{
+			debug_print("ahci.c | ahci_wait() | Port is hung");
+			ahci_recover(port);
 			return FALSE;
 		}
 	}
- 
+
 	// Check again
 	if (port->is & HBA_PxIS_TFES)
 	{
-		debug_print("ahci.c | ahci_read() | Read disk error");
+		debug_print("ahci.c | ahci_wait() | Disk error");
+		ahci_recover(port);
 		return FALSE;
 	}
- 
+
 	return TRUE;
 }
+
+BOOL ahci_transfer(HBA_PORT *port, QWORD start, DWORD count, BYTE *buf, const bool write)
+{
+	struct AHCI_DEVICE* dev = ahci_device(port);
+
+	// The PRDT data base address must be word-aligned
+	if (!dev || (mem_physaddr(buf) & 1))
+	{
+		debug_print("ahci.c | ahci_transfer() | Invalid port or misaligned buffer");
+		return FALSE;
+	}
+
+	BYTE command = 0;
+	if (dev->ncq)
+	{
+		command = (write ? ATA_CMD_WRITE_FPDMA_QUEUED : ATA_CMD_READ_FPDMA_QUEUED);
+	}
+	else
+	{
+		command = (write ? ATA_CMD_WRITE_DMA_EX : ATA_CMD_READ_DMA_EX);
+	}
+
+	port->is = (DWORD)-1; // Clear pending interrupt bits
+	DWORD issued = 0;
+
+	// Wait until the port is no longer busy before issuing a new command
+	uint64_t deadline = timer_ms() + AHCI_TIMEOUT_MS;
+	while (port->tfd & (ATA_DEV_BUSY | ATA_DEV_DRQ))
+	{
+		if (timer_ms() >= deadline)
+		{
+			debug_print("ahci.c | ahci_transfer() | Port is hung");
+			return FALSE;
+		}
+	}
+
+	for (DWORD done = 0; done < count; )
+	{
+		int cmdslot = find_cmdslot(dev);
+
+		// All the slots are in use, wait for any of them to complete
+		if (cmdslot == -1)
+		{
+			deadline = timer_ms() + AHCI_TIMEOUT_MS;
+
+			while ((cmdslot = find_cmdslot(dev)) == -1)
+			{
+				if ((port->is & HBA_PxIS_TFES) || timer_ms() >= deadline)
+				{
+					// Report the error and let the commands that have already been issued finish
+					ahci_wait(port, issued);
+					return FALSE;
+				}
+			}
+		}
+
+		DWORD chunk = (count - done < AHCI_CHUNK_SECTORS ? count - done : AHCI_CHUNK_SECTORS);
+		ahci_setup(dev, cmdslot, command, start + done, chunk, chunk << 9, &buf[done << 9], write);
+
+		// Queued commands must be marked as active before they are issued
+		if (dev->ncq)
+		{
+			port->sact = (DWORD)1 << cmdslot;
+		}
+
+		port->ci = (DWORD)1 << cmdslot; // Issue command
+		issued |= (DWORD)1 << cmdslot;
+		done += chunk;
+	}
+
+	// Wait for completion
+	return ahci_wait(port, issued);
+}
+
+BOOL ahci_read(HBA_PORT *port, QWORD start, DWORD count, WORD *buf)
+{
+	return ahci_transfer(port, start, count, (BYTE*)buf, false);
+}
+
+BOOL ahci_write(HBA_PORT *port, QWORD start, DWORD count, const WORD *buf)
+{
+	// The buffer is only read from when writing
+	return ahci_transfer(port, start, count, (BYTE*)buf, true);
+}
+
+// Reads the identification data of the drive and sets up the command slots it can use
+void ahci_identify(struct AHCI_DEVICE* const dev)
+{
+	WORD* identify = (WORD*)mem_dmaalloc(0x200, 0);
+
+	dev->ncq = false;
+	dev->slots = 1;
+
+	int cmdslot = find_cmdslot(dev);
+	if (cmdslot != -1)
+	{
+		ahci_setup(dev, cmdslot, ATA_CMD_IDENTIFY, 0, 0, 0x200, identify, false);
+		dev->port->ci = (DWORD)1 << cmdslot;
+
+		if (ahci_wait(dev->port, (DWORD)1 << cmdslot))
+		{
+			// Word 76 bit 8 tells whether the drive supports NCQ, word 75 holds its maximum queue depth minus one
+			// The queue depth can't be higher than the number of command slots of the controller
+			DWORD depth = (identify[76] & (1<<8) ? (DWORD)(identify[75] & 0x1F) + 1 : ahciSlots);
+			if (depth > ahciSlots)
+			{
+				depth = ahciSlots;
+			}
+
+			dev->ncq = (identify[76] & (1<<8)) && ahciNcq;
+			dev->slots = (depth >= 32 ? (DWORD)-1 : ((DWORD)1 << depth) - 1);
+		}
+	}
+
+	mem_free(identify);
+}
+
+void probe_port(HBA_MEM *abar)
+{
+	// Search disk in impelemented ports
+	DWORD pi = abar->pi;
+
+	for (size_t i = 0; i < 32; i++)
+	{
+		if (pi & 1)
+		{
+			int dt = check_type(&abar->ports[i]);
+
+			if (dt == AHCI_DEV_SATA)
+			{
+				trace_ahci("SATA drive found at port ", i);
+
+				// Give the port its own memory spaces and find out what the drive supports
+				port_rebase(&abar->ports[i]);
+
+				struct AHCI_DEVICE* dev = &ahciDevices[ahciDeviceCount++];
+				dev->port = &abar->ports[i];
+				ahci_identify(dev);
+
+				if (dev->ncq)
+				{
+					term_writeline("SATA: Native Command Queuing enabled", false);
+				}
+
+				// Store the SATA drive in the HDD array
+				hddAddAHCI(&abar->ports[i]);
+			}
+			else if (dt == (int)AHCI_DEV_SATAPI)
+			{
+				trace_ahci("SATAPI drive found at port ", i);
+			}
+			else if (dt == (int)AHCI_DEV_SEMB)
+			{
+				trace_ahci("SEMB drive found at port ", i);
+			}
+			else if (dt == (int)AHCI_DEV_PM)
+			{
+				trace_ahci("PM drive found at port ", i);
+			}
+			else
+			{
+				//trace_ahci("No drive found at port ", i);
+			}
+		}
+ 
+		pi >>= 1;
+	}
+}
+
+void ahci_init(void)
+{
+	uint8_t bus = 0, slot = 0, func = 0;
+
+	if (!findPciDevice(PCI_CLASS_MASS_STORAGE, PCI_SUBCLASS_SATA, &bus, &slot, &func))
+	{
+		debug_print("ahci.c | ahci_init() | No SATA controller found!");
+		return;
+	}
+
+	// Only AHCI controllers have the programming interface 1
+	if ((BYTE)(pciConfigRead(bus, slot, func, 0x08) >> 8) != 0x01)
+	{
+		debug_print("ahci.c | ahci_init() | The SATA controller isn't an AHCI controller!");
+		return;
+	}
+
+	pciEnableBusMaster(bus, slot, func);
+
+	// BAR5 holds the physical address of the HBA memory registers
+	HBA_MEM* abar = (HBA_MEM*)(pciConfigRead(bus, slot, func, 0x24) & 0xFFFFFFF0);
+
+	// Make sure the controller is in AHCI mode
+	abar->ghc |= HBA_GHC_AE;
+
+	ahciSlots = ((abar->cap >> 8) & 0x1F) + 1;
+	ahciNcq = abar->cap & HBA_CAP_SNCQ;
+
+	term_writeline("PCI: AHCI controller found", false);
+	probe_port(abar);
+}
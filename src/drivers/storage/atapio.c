@@ -5,6 +5,8 @@
 
 #include <assembly.h>
 #include <drivers/memory.h>
+#include <drivers/timer.h>
+#include <kernel.h>
 
 // ATA port I/O register offsets
 const uint16_t REGISTER_DATA         = 0x0;
@@ -17,11 +19,18 @@ const uint16_t REGISTER_DRIVE_HEAD   = 0x6;
 const uint16_t REGISTER_COMMAND      = 0x7;
 const uint16_t REGISTER_STATUS       = 0x7;
 //const uint16_t REGISTER_ALTERNATE_STATUS = 0x106;
+const uint16_t REGISTER_DEVICE_CONTROL = 0x206;
+
+// Software reset bit of the device control register
+const uint8_t DEVICE_CONTROL_RESET = 0x04;
 
 const uint8_t COMMAND_READ           = 0x20;
 const uint8_t COMMAND_READ_EXTENDED  = 0x24;
 const uint8_t COMMAND_WRITE          = 0x30;
 const uint8_t COMMAND_WRITE_EXTENDED = 0x34;
+const uint8_t COMMAND_READ_MULTIPLE_EXTENDED  = 0x29;
+const uint8_t COMMAND_WRITE_MULTIPLE_EXTENDED = 0x39;
+const uint8_t COMMAND_SET_MULTIPLE   = 0xC6;
 const uint8_t COMMAND_IDENTIFY       = 0xEC;
 
 const uint8_t STATUS_BUSY           = 0x80;
@@ -35,17 +44,120 @@ const uint8_t STATUS_ERROR          = 0x01;
 
 const uint8_t PROBE_BYTE = 0xAB;
 
+// Index of the identification data word that holds the maximum number of sectors per READ / WRITE MULTIPLE block
+const size_t IDENTIFY_MULTIPLE_MAX = 47;
+
+// Maximum number of sectors transferred by a single LBA48 command
+const size_t LBA48_COUNT_MAX = 0x10000;
+
+// Number of sectors transferred per data request in multiple mode for each bus and drive
+// 0 means multiple mode isn't enabled and each sector is transferred separately
+static uint8_t multipleBlock[2][2];
+
+// Set by the interrupt handler of each bus when its drive raises an interrupt
+static volatile bool ataInterrupt[2];
+
 //const uint8_t PROBE_DRIVE_MASTER = 0xA0;
 //const uint8_t PROBE_DRIVE_SLAVE = 0xB0;
 
-void awaitStatus(const enum BUS bus, const uint8_t status)
+// Reading the status register acknowledges the drive's interrupt
+void ataInterruptHandler(const enum BUS bus)
+{
+    inb(bus + REGISTER_STATUS);
+    ataInterrupt[bus == BUS_SECONDARY] = true;
+
+    // Enable interrupts again, IRQ14 and IRQ15 come from the slave PIC
+    outb(0xA0, 0x20);
+    outb(0x20, 0x20);
+}
+
+void ata_primary_handler(void)
 {
-    while (!(inb(bus + REGISTER_STATUS) & status)) { }
+    ataInterruptHandler(BUS_PRIMARY);
 }
 
-void awaitStatusFalse(const enum BUS bus, const uint8_t status)
+void ata_secondary_handler(void)
 {
-    while (inb(bus + REGISTER_STATUS) & status) { }
+    // The slave PIC raises IRQ15 when an interrupt disappears before it's acknowledged
+    // Its ISR bit isn't set then, so only the master PIC, which has seen a real IRQ2, gets an EOI
+    outb(0xA0, 0x0B);
+
+    if (!(inb(0xA0) & 0x80))
+    {
+        outb(0x20, 0x20);
+        return;
+    }
+
+    ataInterruptHandler(BUS_SECONDARY);
+}
+
+void ataWait(const enum BUS bus)
+{
+    // Without interrupts nothing could wake the CPU up, the caller keeps polling instead
+    if (!interrupts_enabled())
+    {
+        return;
+    }
+
+    // The interrupt may have arrived since the caller has last checked the drive
+    cli();
+
+    if (ataInterrupt[bus == BUS_SECONDARY])
+    {
+        sti();
+    }
+    else
+    {
+        sti_hlt();
+    }
+
+    ataInterrupt[bus == BUS_SECONDARY] = false;
+}
+
+// Waits until any of the status bits is set, or until none of them is set if set is false
+bool awaitStatusBits(const enum BUS bus, const uint8_t status, const bool set)
+{
+    uint64_t deadline = timer_ms() + ATA_TIMEOUT_MS;
+
+    while (!(inb(bus + REGISTER_STATUS) & status) == set)
+    {
+        if (timer_ms() >= deadline)
+        {
+            debug_print("atapio.c | awaitStatusBits() | The drive has timed out!");
+            return false;
+        }
+
+        ataWait(bus);
+    }
+
+    return true;
+}
+
+bool awaitStatus(const enum BUS bus, const uint8_t status)
+{
+    return awaitStatusBits(bus, status, true);
+}
+
+bool awaitStatusFalse(const enum BUS bus, const uint8_t status)
+{
+    return awaitStatusBits(bus, status, false);
+}
+
+// Waits until the drive is done being busy, returns true if it requests data and false on error
+bool awaitData(const enum BUS bus)
+{
+    if (!awaitStatusFalse(bus, STATUS_BUSY))
+    {
+        return false;
+    }
+
+    uint8_t status = inb(bus + REGISTER_STATUS);
+    return (status & STATUS_REQUEST_READY) && !(status & (STATUS_ERROR | STATUS_WRITE_FAULT));
+}
+
+static inline uint8_t* multipleBlockPtr(const enum BUS bus, const enum DRIVE drive)
+{
+    return &multipleBlock[bus == BUS_SECONDARY][drive];
 }
 
 void switchDrive(const enum BUS bus, const enum DRIVE drive)
@@ -61,6 +173,65 @@ void switchDrive(const enum BUS bus, const enum DRIVE drive)
     inb(bus + REGISTER_STATUS);
 }
 
+// Enables multiple mode with the largest block size supported by the drive
+void setMultipleMode(const enum BUS bus, const enum DRIVE drive, const uint8_t maxBlock)
+{
+    *multipleBlockPtr(bus, drive) = 0;
+
+    // Multiple mode is only worth it if more than a single sector can be transferred per data request
+    if (maxBlock < 2)
+    {
+        return;
+    }
+
+    // The block size must be a power of 2
+    uint8_t block = (uint8_t)(1 << (31 - __builtin_clz(maxBlock)));
+
+    outb(bus + REGISTER_SECTOR_COUNT, block);
+    outb(bus + REGISTER_COMMAND, COMMAND_SET_MULTIPLE);
+
+    if (awaitStatusFalse(bus, STATUS_BUSY) && !(inb(bus + REGISTER_STATUS) & (STATUS_ERROR | STATUS_WRITE_FAULT)))
+    {
+        *multipleBlockPtr(bus, drive) = block;
+    }
+}
+
+bool resetBus(const enum BUS bus)
+{
+    // SRST must be held for at least 5 us, waiting for 2 ticks of the timer guarantees at least 1 ms
+    outb(bus + REGISTER_DEVICE_CONTROL, DEVICE_CONTROL_RESET);
+
+    uint64_t release = timer_ms() + 2;
+    while (timer_ms() < release);
+
+    // Clearing the register releases the reset and keeps the drives' interrupts enabled
+    outb(bus + REGISTER_DEVICE_CONTROL, 0x00);
+
+    // The drives may not report being busy right away
+    release = timer_ms() + 2;
+    while (timer_ms() < release);
+
+    if (!awaitStatusFalse(bus, STATUS_BUSY))
+    {
+        debug_print("atapio.c | resetBus() | The drives are still busy after the reset!");
+        return false;
+    }
+
+    // The reset may have disabled multiple mode, it's enabled again with the same block size
+    for (uint8_t drive = DRIVE_MASTER; drive <= DRIVE_SLAVE; drive++)
+    {
+        uint8_t block = *multipleBlockPtr(bus, (enum DRIVE)drive);
+
+        if (block)
+        {
+            switchDrive(bus, (enum DRIVE)drive);
+            setMultipleMode(bus, (enum DRIVE)drive, block);
+        }
+    }
+
+    return true;
+}
+
 bool ideIdentify(const enum BUS bus, const enum DRIVE drive)
 {
     switchDrive(bus, drive);
@@ -73,25 +244,30 @@ bool ideIdentify(const enum BUS bus, const enum DRIVE drive)
     outb(bus + REGISTER_COMMAND, COMMAND_IDENTIFY);
     uint8_t status = inb(bus + REGISTER_STATUS);
 
-    if (status)
+    // A hung drive may never stop being busy, it's treated as if it wasn't there
+    if (status && awaitStatusFalse(bus, STATUS_BUSY))
     {
-        awaitStatusFalse(bus, STATUS_BUSY);
-
         if (!inb(bus + REGISTER_LBA_MID) && !inb(bus + REGISTER_LBA_HIGH))
         {
-            awaitStatus(bus, STATUS_REQUEST_READY | STATUS_ERROR);
-
-            if (inb(bus + REGISTER_STATUS) & STATUS_REQUEST_READY)
+            if (awaitStatus(bus, STATUS_REQUEST_READY | STATUS_ERROR) && (inb(bus + REGISTER_STATUS) & STATUS_REQUEST_READY))
             {
+                uint8_t multipleMax = 0;
+
                 // Read the indentification data from the drive
                 for (size_t idx = 0; idx < 256; idx++)
                 {
                     // The identification data MUST BE read from the drive
-                    // so let's read it and then dump it immediately
-                    // because we don't need it for anything
-                    inw(bus + REGISTER_DATA);
+                    // but only the multiple mode block size is needed
+                    uint16_t word = inw(bus + REGISTER_DATA);
+
+                    if (idx == IDENTIFY_MULTIPLE_MAX)
+                    {
+                        multipleMax = (uint8_t)word;
+                    }
                 }
 
+                setMultipleMode(bus, drive, multipleMax);
+
                 return true;
             }
         }
@@ -102,6 +278,9 @@ bool ideIdentify(const enum BUS bus, const enum DRIVE drive)
 
 bool probeBus(const enum BUS bus)
 {
+    // Clearing the device control register makes sure the drives on the bus raise interrupts
+    outb(bus + REGISTER_DEVICE_CONTROL, 0x00);
+
     outb(bus + REGISTER_LBA_LOW, PROBE_BYTE);
     uint8_t probeResponse = inb(bus + REGISTER_LBA_LOW);
 
@@ -120,10 +299,11 @@ bool probeDrive(const enum BUS bus, const enum DRIVE drive)
     return (status & STATUS_READY) && identified;
 }
 
-void setupLBA28(const enum BUS bus, const enum DRIVE drive, const uint32_t addr)
+void setupLBA28(const enum BUS bus, const enum DRIVE drive, const uint32_t addr, const size_t count)
 {
+    // Sector count of 0 means 256 sectors
     outb(bus + REGISTER_ERROR, 0x00);
-    outb(bus + REGISTER_SECTOR_COUNT, 0x01);
+    outb(bus + REGISTER_SECTOR_COUNT, (uint8_t)count);
 
     outb(bus + REGISTER_LBA_LOW, (uint8_t)addr);
     outb(bus + REGISTER_LBA_MID, (uint8_t)(addr >> 8));
@@ -132,13 +312,14 @@ void setupLBA28(const enum BUS bus, const enum DRIVE drive, const uint32_t addr)
     outb(bus + REGISTER_DRIVE_HEAD, 0xE0 | (drive << 4) | ((addr >> 24) & 0x0F));
 }
 
-void setupLBA48(const enum BUS bus, const enum DRIVE drive, const uint64_t addr)
+void setupLBA48(const enum BUS bus, const enum DRIVE drive, const uint64_t addr, const size_t count)
 {
+    // Sector count of 0 means 65536 sectors
     outb(bus + REGISTER_ERROR, 0x00);
     outb(bus + REGISTER_ERROR, 0x00);
 
-    outb(bus + REGISTER_SECTOR_COUNT, 0x00);
-    outb(bus + REGISTER_SECTOR_COUNT, 0x01);
+    outb(bus + REGISTER_SECTOR_COUNT, (uint8_t)(count >> 8));
+    outb(bus + REGISTER_SECTOR_COUNT, (uint8_t)count);
 
     outb(bus + REGISTER_LBA_LOW, (uint8_t)(addr >> 24));
     outb(bus + REGISTER_LBA_LOW, (uint8_t)addr);
@@ -150,59 +331,116 @@ void setupLBA48(const enum BUS bus, const enum DRIVE drive, const uint64_t addr)
     outb(bus + REGISTER_DRIVE_HEAD, 0x40 | (drive << 4));
 }
 
-uint8_t* readLBA(const enum BUS bus)
+// Reads count sectors from the data register into the buffer
+// The data register holds the sector in little-endian words, the same byte order as x86 memory
+void readLBA(const enum BUS bus, uint8_t* const buffer, const size_t count)
 {
-    uint8_t* ptrBuff = (uint8_t*)mem_dynalloc(512);
-    uint16_t tmpword = 0;
+    rep_insw(bus + REGISTER_DATA, buffer, count << 8);
+}
 
-    awaitStatus(bus, STATUS_REQUEST_READY);
+// Writes count sectors from the buffer to the data register
+void writeLBA(const enum BUS bus, const uint8_t* const buffer, const size_t count)
+{
+    rep_outsw(bus + REGISTER_DATA, buffer, count << 8);
+}
 
-    for (size_t idx = 0; idx < 256; idx++)
+// Transfers the data of a command that has already been issued
+// The drive requests data once per sector, or once per block of sectors in multiple mode
+bool transferLBA(const enum BUS bus, uint8_t* const buffer, const size_t count, const size_t block, const bool write)
+{
+    for (size_t done = 0; done < count; done += block)
     {
-        tmpword = inw(bus + REGISTER_DATA);
-        ptrBuff[(idx << 1)] = (uint8_t)tmpword;
-        ptrBuff[(idx << 1) + 1] = (uint8_t)(tmpword >> 8);
+        size_t chunk = (count - done < block ? count - done : block);
+
+        if (!awaitData(bus))
+        {
+            debug_print("atapio.c | transferLBA() | The drive reported an error!");
+            return false;
+        }
+
+        if (write)
+        {
+            writeLBA(bus, &buffer[done << 9], chunk);
+        }
+        else
+        {
+            readLBA(bus, &buffer[done << 9], chunk);
+        }
+    }
+
+    // Wait for the drive to finish writing the last block
+    return awaitStatusFalse(bus, STATUS_BUSY);
+}
+
+// Issues as few READ / WRITE commands as possible to transfer count sectors
+bool commandLBA48(const enum BUS bus, const enum DRIVE drive, const uint64_t addr, const size_t count, uint8_t* const buffer, const bool write)
+{
+    size_t block = *multipleBlockPtr(bus, drive);
+    uint8_t command = 0;
+
+    if (block)
+    {
+        command = (write ? COMMAND_WRITE_MULTIPLE_EXTENDED : COMMAND_READ_MULTIPLE_EXTENDED);
+    }
+    else
+    {
+        command = (write ? COMMAND_WRITE_EXTENDED : COMMAND_READ_EXTENDED);
+        block = 1;
+    }
+
+    for (size_t done = 0; done < count; done += LBA48_COUNT_MAX)
+    {
+        size_t chunk = (count - done < LBA48_COUNT_MAX ? count - done : LBA48_COUNT_MAX);
+
+        setupLBA48(bus, drive, addr + done, chunk);
+        outb(bus + REGISTER_COMMAND, command);
+
+        if (!transferLBA(bus, &buffer[done << 9], chunk, block, write))
+        {
+            return false;
+        }
     }
 
-    return ptrBuff;
+    return true;
 }
 
 uint8_t* readLBA28(const enum BUS bus, const enum DRIVE drive, const uint32_t addr)
 {
-    setupLBA28(bus, drive, addr);
+    uint8_t* buffer = (uint8_t*)mem_dynalloc(512);
+
+    setupLBA28(bus, drive, addr, 1);
     outb(bus + REGISTER_COMMAND, COMMAND_READ);
-    return readLBA(bus);
+    transferLBA(bus, buffer, 1, 1, false);
+
+    return buffer;
 }
 
 uint8_t* readLBA48(const enum BUS bus, const enum DRIVE drive, const uint64_t addr)
 {
-    setupLBA48(bus, drive, addr);
-    outb(bus + REGISTER_COMMAND, COMMAND_READ_EXTENDED);
-    return readLBA(bus);
+    uint8_t* buffer = (uint8_t*)mem_dynalloc(512);
+    readLBA48Into(bus, drive, addr, 1, buffer);
+    return buffer;
 }
 
-void writeLBA(const enum BUS bus, const uint8_t* const buffer)
+bool readLBA48Into(const enum BUS bus, const enum DRIVE drive, const uint64_t addr, const size_t count, uint8_t* const buffer)
 {
-    awaitStatus(bus, STATUS_REQUEST_READY);
-
-    for (size_t idx = 0; idx < 256; idx++)
-    {
-        outw(bus + REGISTER_DATA, ((uint16_t)buffer[idx << 1]) | (((uint16_t)buffer[(idx << 1) + 1]) << 8));
-    }
-
-    awaitStatusFalse(bus, STATUS_BUSY);
+    return commandLBA48(bus, drive, addr, count, buffer, false);
 }
 
 void writeLBA28(const enum BUS bus, const enum DRIVE drive, const uint32_t addr, const uint8_t* const buffer)
 {
-    setupLBA28(bus, drive, addr);
+    setupLBA28(bus, drive, addr, 1);
     outb(bus + REGISTER_COMMAND, COMMAND_WRITE);
-    writeLBA(bus, buffer);
+    transferLBA(bus, (uint8_t*)buffer, 1, 1, true);
 }
 
 void writeLBA48(const enum BUS bus, const enum DRIVE drive, const uint64_t addr, const uint8_t* const buffer)
 {
-    setupLBA48(bus, drive, addr);
-    outb(bus + REGISTER_COMMAND, COMMAND_WRITE_EXTENDED);
-    writeLBA(bus, buffer);
+    writeLBA48From(bus, drive, addr, 1, buffer);
+}
+
+bool writeLBA48From(const enum BUS bus, const enum DRIVE drive, const uint64_t addr, const size_t count, const uint8_t* const buffer)
+{
+    // The buffer is only read from when writing
+    return commandLBA48(bus, drive, addr, count, (uint8_t*)buffer, true);
 }
@@ -0,0 +1,357 @@
+#include <drivers/storage/cache.h>
+#include <drivers/storage/harddrive.h>
+#include <drivers/memory.h>
+#include <kernel.h>
+
+// Number of hash buckets, must be a power of 2
+#define CACHE_HASH_SIZE 0x400
+#define CACHE_HASH_BITS 10
+// Used instead of a block index when there is no such block
+#define CACHE_NONE 0xFFFF
+// Number of dirty sectors an eviction tries to write before it gives up
+#define CACHE_EVICT_ATTEMPTS 4
+
+// A single cached sector, blocks are kept in a list ordered from the most to the least recently used
+struct CACHE_BLOCK
+{
+    uint64_t lba;
+    uint8_t hddIdx;
+    bool valid;        // the block holds a sector
+    bool dirty;        // the sector has been modified and hasn't been written to the disk yet
+    uint16_t prev;     // more recently used block
+    uint16_t next;     // less recently used block
+    uint16_t hashNext; // next block in the same hash bucket
+};
+
+static struct CACHE_BLOCK cacheBlocks[CACHE_BLOCKS];
+static uint16_t cacheHash[CACHE_HASH_SIZE];
+static uint16_t cacheHead = CACHE_NONE; // most recently used block
+static uint16_t cacheTail = CACHE_NONE; // least recently used block, the next one to be evicted
+// Content of the cached sectors, allocated when the cache is first used
+static uint8_t* cacheData = (uint8_t*)0;
+
+static struct CACHE_STATS cacheStats;
+
+static inline uint8_t* _cachedata(const uint16_t idx)
+{
+    return &cacheData[((size_t)idx) << 9];
+}
+
+static inline size_t _cachehash(const uint8_t hddIdx, const uint64_t lba)
+{
+    return (((uint32_t)lba ^ ((uint32_t)hddIdx << 24)) * 0x9E3779B1) >> (32 - CACHE_HASH_BITS);
+}
+
+void _cacheinit(void)
+{
+    // Sectors are read into the cache by the disk controllers, so it must be suitable for DMA
+    cacheData = (uint8_t*)mem_dmaalloc(CACHE_BLOCKS << 9, 0);
+
+    for (size_t i = 0; i < CACHE_HASH_SIZE; i++)
+    {
+        cacheHash[i] = CACHE_NONE;
+    }
+
+    // All the blocks are empty and linked in the order of their indices
+    for (size_t i = 0; i < CACHE_BLOCKS; i++)
+    {
+        cacheBlocks[i].valid = false;
+        cacheBlocks[i].dirty = false;
+        cacheBlocks[i].prev = (i ? i - 1 : CACHE_NONE);
+        cacheBlocks[i].next = (i + 1 < CACHE_BLOCKS ? i + 1 : CACHE_NONE);
+    }
+
+    cacheHead = 0;
+    cacheTail = CACHE_BLOCKS - 1;
+}
+
+// Returns the block holding a sector or CACHE_NONE if the sector isn't cached
+uint16_t _cachefind(const uint8_t hddIdx, const uint64_t lba)
+{
+    uint16_t idx = cacheHash[_cachehash(hddIdx, lba)];
+
+    while (idx != CACHE_NONE && (cacheBlocks[idx].lba != lba || cacheBlocks[idx].hddIdx != hddIdx))
+    {
+        idx = cacheBlocks[idx].hashNext;
+    }
+
+    return idx;
+}
+
+void _cacheunlink(const uint16_t idx)
+{
+    struct CACHE_BLOCK* block = &cacheBlocks[idx];
+
+    if (block->prev != CACHE_NONE)
+    {
+        cacheBlocks[block->prev].next = block->next;
+    }
+    else
+    {
+        cacheHead = block->next;
+    }
+
+    if (block->next != CACHE_NONE)
+    {
+        cacheBlocks[block->next].prev = block->prev;
+    }
+    else
+    {
+        cacheTail = block->prev;
+    }
+}
+
+// Marks the block as the most recently used one
+void _cachetouch(const uint16_t idx)
+{
+    if (cacheHead == idx)
+    {
+        return;
+    }
+
+    _cacheunlink(idx);
+
+    cacheBlocks[idx].prev = CACHE_NONE;
+    cacheBlocks[idx].next = cacheHead;
+    cacheBlocks[cacheHead].prev = idx;
+    cacheHead = idx;
+}
+
+// Removes the sector from the cache without writing it, the empty block becomes the next one to be evicted
+void _cachedrop(const uint16_t idx)
+{
+    struct CACHE_BLOCK* block = &cacheBlocks[idx];
+    uint16_t* link = &cacheHash[_cachehash(block->hddIdx, block->lba)];
+
+    while (*link != idx)
+    {
+        link = &cacheBlocks[*link].hashNext;
+    }
+
+    *link = block->hashNext;
+
+    if (block->dirty)
+    {
+        block->dirty = false;
+        cacheStats.dirty--;
+    }
+
+    block->valid = false;
+
+    if (cacheTail != idx)
+    {
+        _cacheunlink(idx);
+
+        block->prev = cacheTail;
+        block->next = CACHE_NONE;
+        cacheBlocks[cacheTail].next = idx;
+        cacheTail = idx;
+    }
+}
+
+bool _cachewriteback(const uint16_t idx)
+{
+    struct CACHE_BLOCK* block = &cacheBlocks[idx];
+
+    if (!hddWriteDirect(block->hddIdx, block->lba, 1, _cachedata(idx)))
+    {
+        debug_print("cache.c | _cachewriteback() | Unable to write a dirty sector to the disk!");
+        return false;
+    }
+
+    block->dirty = false;
+    cacheStats.dirty--;
+    cacheStats.writebacks++;
+    return true;
+}
+
+// Frees the least recently used block whose sector isn't the only copy of some data
+// Returns CACHE_NONE if the dirty sectors can't be written to the disk
+uint16_t _cacheevict(void)
+{
+    size_t failures = 0;
+
+    for (uint16_t idx = cacheTail; idx != CACHE_NONE; idx = cacheBlocks[idx].prev)
+    {
+        // A dirty sector must reach the disk before its block can be reused, otherwise it stays in the cache
+        if (cacheBlocks[idx].valid && cacheBlocks[idx].dirty && !_cachewriteback(idx))
+        {
+            // Each failed write can take a whole timeout, so don't try every dirty sector of a dead disk
+            if (++failures >= CACHE_EVICT_ATTEMPTS)
+            {
+                break;
+            }
+
+            continue;
+        }
+
+        if (cacheBlocks[idx].valid)
+        {
+            _cachedrop(idx);
+        }
+
+        return idx;
+    }
+
+    debug_print("cache.c | _cacheevict() | Unable to free a cache block!");
+    return CACHE_NONE;
+}
+
+// Stores a sector in the cache, reusing the least recently used block if the sector isn't cached yet
+// Returns false if no block could be freed for the sector
+bool _cacheinsert(const uint8_t hddIdx, const uint64_t lba, const uint8_t* const data, const bool dirty)
+{
+    uint16_t idx = _cachefind(hddIdx, lba);
+
+    if (idx == CACHE_NONE)
+    {
+        idx = _cacheevict();
+
+        if (idx == CACHE_NONE)
+        {
+            return false;
+        }
+
+        size_t hash = _cachehash(hddIdx, lba);
+
+        cacheBlocks[idx].hddIdx = hddIdx;
+        cacheBlocks[idx].lba = lba;
+        cacheBlocks[idx].valid = true;
+        cacheBlocks[idx].hashNext = cacheHash[hash];
+        cacheHash[hash] = idx;
+    }
+
+    mem_copy(data, _cachedata(idx), 0x200);
+
+    if (dirty && !cacheBlocks[idx].dirty)
+    {
+        cacheStats.dirty++;
+    }
+
+    cacheBlocks[idx].dirty |= dirty;
+    _cachetouch(idx);
+    return true;
+}
+
+bool cache_read(const uint8_t hddIdx, const uint64_t lba, const size_t count, uint8_t* const buffer)
+{
+    if (!cacheData)
+    {
+        _cacheinit();
+    }
+
+    if (count >= CACHE_BYPASS_SECTORS)
+    {
+        if (!hddReadDirect(hddIdx, lba, count, buffer))
+        {
+            return false;
+        }
+
+        // Sectors modified in the cache are newer than their copies on the disk
+        for (uint16_t i = 0; i < CACHE_BLOCKS; i++)
+        {
+            if (cacheBlocks[i].valid && cacheBlocks[i].dirty && cacheBlocks[i].hddIdx == hddIdx &&
+                cacheBlocks[i].lba >= lba && cacheBlocks[i].lba < lba + count)
+            {
+                mem_copy(_cachedata(i), &buffer[(cacheBlocks[i].lba - lba) << 9], 0x200);
+            }
+        }
+
+        return true;
+    }
+
+    for (size_t i = 0; i < count; )
+    {
+        uint16_t idx = _cachefind(hddIdx, lba + i);
+
+        if (idx != CACHE_NONE)
+        {
+            mem_copy(_cachedata(idx), &buffer[i << 9], 0x200);
+            _cachetouch(idx);
+
+            cacheStats.hits++;
+            i++;
+            continue;
+        }
+
+        // Consecutive missing sectors are read from the disk together, straight into the buffer
+        size_t end = i + 1;
+        while (end < count && _cachefind(hddIdx, lba + end) == CACHE_NONE)
+        {
+            end++;
+        }
+
+        if (!hddReadDirect(hddIdx, lba + i, end - i, &buffer[i << 9]))
+        {
+            return false;
+        }
+
+        // The sectors have been read either way, they're just not cached if there's no room for them
+        for (; i < end; i++)
+        {
+            _cacheinsert(hddIdx, lba + i, &buffer[i << 9], false);
+            cacheStats.misses++;
+        }
+    }
+
+    return true;
+}
+
+bool cache_write(const uint8_t hddIdx, const uint64_t lba, const size_t count, const uint8_t* const buffer)
+{
+    if (!cacheData)
+    {
+        _cacheinit();
+    }
+
+    if (count >= CACHE_BYPASS_SECTORS)
+    {
+        // Cached copies of the sectors are outdated now
+        for (uint16_t i = 0; i < CACHE_BLOCKS; i++)
+        {
+            if (cacheBlocks[i].valid && cacheBlocks[i].hddIdx == hddIdx &&
+                cacheBlocks[i].lba >= lba && cacheBlocks[i].lba < lba + count)
+            {
+                _cachedrop(i);
+            }
+        }
+
+        return hddWriteDirect(hddIdx, lba, count, buffer);
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        // Without a free block the sector has to be written right away
+        if (!_cacheinsert(hddIdx, lba + i, &buffer[i << 9], true) && !hddWriteDirect(hddIdx, lba + i, 1, &buffer[i << 9]))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool cache_flush(void)
+{
+    bool success = true;
+
+    if (!cacheData || !cacheStats.dirty)
+    {
+        return true;
+    }
+
+    for (uint16_t i = 0; i < CACHE_BLOCKS; i++)
+    {
+        if (cacheBlocks[i].valid && cacheBlocks[i].dirty && !_cachewriteback(i))
+        {
+            success = false;
+        }
+    }
+
+    return success;
+}
+
+void cache_stats(struct CACHE_STATS* const stats)
+{
+    *stats = cacheStats;
+}
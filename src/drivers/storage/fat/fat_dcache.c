@@ -0,0 +1,114 @@
+#include <drivers/storage/fat.h>
+#include <drivers/memory.h>
+
+// Number of directory entries remembered by the cache
+#define DCACHE_SIZE 0x40
+
+// Cached result of looking up a name in a directory
+struct DCACHE_ENTRY
+{
+    bool valid;
+    bool found;              // false for a negative entry, the directory doesn't contain the name
+    uint8_t partIdx;
+    uint32_t dirCluster;     // first cluster of the directory that was searched
+    char fileName[11];       // the searched name in the FAT format
+    uint32_t lastUse;
+    struct DIR_ENTRY entry;  // copy of the directory entry, only if found
+};
+
+static struct DCACHE_ENTRY dcache[DCACHE_SIZE];
+static uint32_t dcacheClock = 0;
+
+// Returns the cache entry for the name or nullptr if the name isn't cached
+static struct DCACHE_ENTRY* dcacheFind(const uint8_t partIdx, const uint32_t dirCluster, const char* const fileName)
+{
+    for (size_t i = 0; i < DCACHE_SIZE; i++)
+    {
+        if (dcache[i].valid && dcache[i].dirCluster == dirCluster && dcache[i].partIdx == partIdx && fileNameEqual(dcache[i].fileName, fileName))
+        {
+            return &dcache[i];
+        }
+    }
+
+    return (struct DCACHE_ENTRY*)0;
+}
+
+bool dcacheLookup(const uint8_t partIdx, const uint32_t dirCluster, const char* const fileName, bool* const found, struct DIR_ENTRY* const entry)
+{
+    struct DCACHE_ENTRY* cached = dcacheFind(partIdx, dirCluster, fileName);
+
+    if (!cached)
+    {
+        return false;
+    }
+
+    cached->lastUse = ++dcacheClock;
+    *found = cached->found;
+
+    if (cached->found)
+    {
+        mem_copy(&cached->entry, entry, sizeof(struct DIR_ENTRY));
+    }
+
+    return true;
+}
+
+void dcacheInsert(const uint8_t partIdx, const uint32_t dirCluster, const char* const fileName, const struct DIR_ENTRY* const entry)
+{
+    struct DCACHE_ENTRY* cached = dcacheFind(partIdx, dirCluster, fileName);
+
+    // Replace an empty entry or the least recently used one
+    for (size_t i = 0; i < DCACHE_SIZE && !cached; i++)
+    {
+        if (!dcache[i].valid)
+        {
+            cached = &dcache[i];
+        }
+    }
+
+    if (!cached)
+    {
+        cached = &dcache[0];
+
+        for (size_t i = 1; i < DCACHE_SIZE; i++)
+        {
+            if (dcache[i].lastUse < cached->lastUse)
+            {
+                cached = &dcache[i];
+            }
+        }
+    }
+
+    cached->valid = true;
+    cached->found = !!entry;
+    cached->partIdx = partIdx;
+    cached->dirCluster = dirCluster;
+    mem_copy(fileName, cached->fileName, sizeof(cached->fileName));
+    cached->lastUse = ++dcacheClock;
+
+    if (entry)
+    {
+        mem_copy(entry, &cached->entry, sizeof(struct DIR_ENTRY));
+    }
+}
+
+void dcacheInvalidate(const uint8_t partIdx, const uint32_t dirCluster, const char* const fileName)
+{
+    struct DCACHE_ENTRY* cached = dcacheFind(partIdx, dirCluster, fileName);
+
+    if (cached)
+    {
+        cached->valid = false;
+    }
+}
+
+void dcacheInvalidateDir(const uint8_t partIdx, const uint32_t dirCluster)
+{
+    for (size_t i = 0; i < DCACHE_SIZE; i++)
+    {
+        if (dcache[i].valid && dcache[i].dirCluster == dirCluster && dcache[i].partIdx == partIdx)
+        {
+            dcache[i].valid = false;
+        }
+    }
+}
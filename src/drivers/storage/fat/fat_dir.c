@@ -12,151 +12,578 @@ uint64_t clusterToSector(const uint8_t partIdx, const uint32_t clust)
     return fatBegin + fatSectors + (partArray[partIdx].sectorsPerCluster * (clust - 2));
 }
 
-uint32_t* getClusterChain(const uint8_t partIdx, const uint32_t firstClust)
+// Appends a cluster to an array of extents, either by extending the last extent or by adding a new one
+// The array grows geometrically, so that building it is linear in the number of extents
+static struct CLUSTER_EXTENT* appendExtent(struct CLUSTER_EXTENT* const extents, size_t* const extentCount, const uint32_t clust)
+{
+    struct CLUSTER_EXTENT* ext = extents;
+
+    if (*extentCount && ext[*extentCount - 1].start + ext[*extentCount - 1].length == clust)
+    {
+        ext[*extentCount - 1].length++;
+        return ext;
+    }
+
+    if ((*extentCount + 1) * sizeof(struct CLUSTER_EXTENT) > mem_dynsize(ext))
+    {
+        ext = mem_dynresize(ext, (*extentCount + 1) * 2 * sizeof(struct CLUSTER_EXTENT));
+    }
+
+    ext[*extentCount].start = clust;
+    ext[*extentCount].length = 1;
+    (*extentCount)++;
+    return ext;
+}
+
+// Follows a cluster chain in the FAT and stores it as extents
+static struct CLUSTER_EXTENT* buildExtents(const uint8_t partIdx, const uint32_t firstClust)
 {
-    // Calculate the sector offset of the first cluster
-    size_t fatBegin = partArray[partIdx].lbaBegin + partArray[partIdx].reservedSectors;
     // Calculate the total number of clusters on this partition
     size_t clusterCount = partArray[partIdx].fatSectors * 0x80;
 
-    // Allocate memory space for the cluster chain
-    uint32_t* clusterChain = mem_dynalloc(0);
-    size_t chainSize = 0;
-
-    // Follow the cluster chain
-    uint32_t currClust = firstClust;
+    struct CLUSTER_EXTENT* extents = mem_dynalloc(4 * sizeof(struct CLUSTER_EXTENT));
+    size_t extentCount = 0;
 
     // The cluster chain terminator sign is higher than the total number of clusters
-    while (currClust < clusterCount)
+    for (uint32_t currClust = firstClust; currClust < clusterCount; currClust = partArray[partIdx].fat[currClust])
     {
         // Clusters in a chain should never point to a cluster 0 or cluster 1, because those are never used
         if (currClust < 2)
         {
-            debug_print("fat_dir.c | getClusterChain() | Found an error in the cluster chain!");
+            debug_print("fat_dir.c | buildExtents() | Found an error in the cluster chain!");
+            break;
+        }
+
+        extents = appendExtent(extents, &extentCount, currClust);
+    }
+
+    // Terminate the array, the chain only contains the valid clusters found before any error
+    if ((extentCount + 1) * sizeof(struct CLUSTER_EXTENT) > mem_dynsize(extents))
+    {
+        extents = mem_dynresize(extents, (extentCount + 1) * sizeof(struct CLUSTER_EXTENT));
+    }
+
+    extents[extentCount].start = 0;
+    extents[extentCount].length = 0;
+
+    return extents;
+}
+
+// Returns the cached extents of a cluster chain, the FAT is only walked if the chain isn't cached or the FAT has changed
+// The returned array belongs to the cache, so it's only valid until the next lookup
+static const struct CLUSTER_EXTENT* cachedExtents(const uint8_t partIdx, const uint32_t firstClust, size_t* const extentCount)
+{
+    struct PARTITION* part = &partArray[partIdx];
+    struct CHAIN_CACHE_ENTRY* entry = (struct CHAIN_CACHE_ENTRY*)0;
+
+    for (size_t i = 0; i < CHAIN_CACHE_SIZE; i++)
+    {
+        struct CHAIN_CACHE_ENTRY* candidate = &part->chainCache[i];
+
+        if (candidate->extents && candidate->firstClust == firstClust)
+        {
+            entry = candidate;
+            break;
+        }
 
-            // Terminate the cluster chain so that it only contains valid clusters and return it
-            clusterChain = mem_dynresize(clusterChain, ++chainSize * 4);
-            clusterChain[chainSize - 1] = CLUSTER_CHAIN_TERMINATOR;
+        // Otherwise an empty entry or the least recently used one is replaced
+        if (!entry || (entry->extents && (!candidate->extents || candidate->lastUse < entry->lastUse)))
+        {
+            entry = candidate;
+        }
+    }
 
-            return clusterChain;
+    if (!entry->extents || entry->firstClust != firstClust || entry->generation != part->fatGeneration)
+    {
+        if (entry->extents)
+        {
+            mem_free(entry->extents);
         }
 
-        // Add the cluster to the chain
-        clusterChain = mem_dynresize(clusterChain, ++chainSize * 4);
-        clusterChain[chainSize - 1] = currClust;
+        entry->firstClust = firstClust;
+        entry->generation = part->fatGeneration;
+        entry->extents = buildExtents(partIdx, firstClust);
+    }
+
+    entry->lastUse = ++part->chainCacheClock;
+
+    size_t count = 0;
+    while (entry->extents[count].length)
+    {
+        count++;
+    }
+
+    *extentCount = count;
+    return entry->extents;
+}
+
+struct CLUSTER_EXTENT* getClusterExtents(const uint8_t partIdx, const uint32_t firstClust)
+{
+    size_t extentCount = 0;
+    const struct CLUSTER_EXTENT* cached = cachedExtents(partIdx, firstClust, &extentCount);
+
+    // The caller gets its own copy, so that it stays valid while the cache changes
+    struct CLUSTER_EXTENT* extents = mem_dynalloc((extentCount + 1) * sizeof(struct CLUSTER_EXTENT));
+    mem_copy(cached, extents, (extentCount + 1) * sizeof(struct CLUSTER_EXTENT));
+
+    return extents;
+}
+
+uint32_t* getClusterChain(const uint8_t partIdx, const uint32_t firstClust)
+{
+    size_t extentCount = 0;
+    const struct CLUSTER_EXTENT* extents = cachedExtents(partIdx, firstClust, &extentCount);
+
+    // Count the clusters, so that the whole chain is allocated at once
+    size_t chainSize = 0;
+    for (size_t i = 0; i < extentCount; i++)
+    {
+        chainSize += extents[i].length;
+    }
 
-        // Calculate the sector that leads to the next cluster in the chain
-        size_t readsec = fatBegin + (currClust / 0x80);
-        size_t fatentry = currClust % 0x80;
+    uint32_t* clusterChain = mem_dynalloc((chainSize + 1) * sizeof(uint32_t));
+    size_t chainIdx = 0;
 
-        // Read the sector which holds the information about the next cluster in currently processed chain
-        struct FAT_TABLE* fat = (struct FAT_TABLE*)hddRead(partArray[partIdx].hddIdx, readsec);
-        currClust = fat->entries[fatentry];
-        mem_free(fat);
+    // Expand the extents into individual clusters
+    for (size_t i = 0; i < extentCount; i++)
+    {
+        for (uint32_t j = 0; j < extents[i].length; j++)
+        {
+            clusterChain[chainIdx++] = extents[i].start + j;
+        }
     }
 
     // Save the terminator sign to the end of the cluster chain
-    clusterChain = mem_dynresize(clusterChain, ++chainSize * 4);
-    clusterChain[chainSize - 1] = CLUSTER_CHAIN_TERMINATOR;
+    clusterChain[chainIdx] = CLUSTER_CHAIN_TERMINATOR;
 
     return clusterChain;
 }
 
+// Returns the first cluster marked as free in the bitmap between begin and end, 0 if there's none
+static uint32_t findFreeInMap(const uint32_t* const freeMap, const uint32_t begin, const uint32_t end)
+{
+    for (uint32_t clustIdx = begin; clustIdx < end; )
+    {
+        uint32_t bits = freeMap[clustIdx >> 5] >> (clustIdx & 0x1F);
+
+        // Skip the rest of the word if none of its clusters are free
+        if (!bits)
+        {
+            clustIdx = (clustIdx | 0x1F) + 1;
+            continue;
+        }
+
+        clustIdx += __builtin_ctz(bits);
+        return clustIdx < end ? clustIdx : 0;
+    }
+
+    return 0;
+}
+
 uint32_t findEmptyCluster(const uint8_t partIdx)
 {
-    // Calculate the sector offset
-    size_t fatBegin = partArray[partIdx].lbaBegin + partArray[partIdx].reservedSectors;
+    struct PARTITION* part = &partArray[partIdx];
+    uint32_t clustIdx = 0;
 
-    // Go through the FAT tables until an empty cluster is found
-    for (size_t secIdx = 0; secIdx < partArray[partIdx].fatSectors; secIdx++)
+    if (part->freeClusters)
     {
-        // Read the FAT table from the disk
-        struct FAT_TABLE* fat = (struct FAT_TABLE*)hddRead(partArray[partIdx].hddIdx, fatBegin + secIdx);
+        // Continue where the last allocation ended and wrap around to the beginning of the partition
+        clustIdx = findFreeInMap(part->freeMap, part->nextFree, part->clusterCount);
 
-        // Each FAT table contains 128 entries
-        for (size_t entryIdx = (secIdx ? 0 : 2); entryIdx < 0x80; entryIdx++)
+        if (!clustIdx)
         {
-            // An empty cluster is marked by the value 0
-            if (!fat->entries[entryIdx])
-            {
-                mem_free(fat);
-                // Return the cluster index
-                return (secIdx * 0x80) + entryIdx;
-            }
-        }       
+            clustIdx = findFreeInMap(part->freeMap, 2, part->nextFree);
+        }
+    }
 
-        mem_free(fat);
+    if (!clustIdx)
+    {
+        // No empty cluster found, return 0
+        debug_print("fat_dir.c | findEmptyCluster() | Couldn't find an empty cluster!");
     }
 
-    // No empty cluster found, return 0
-    debug_print("fat_dir.c | findEmptyCluster() | Couldn't find an empty cluster!");
-    return 0;
+    return clustIdx;
 }
 
-void fatWrite(const uint8_t partIdx, const uint32_t clustIdx, const uint32_t content)
+// Builds the free cluster bitmap from the FAT and reads the next free cluster hint from the FSInfo sector
+static void loadFreeMap(const uint8_t partIdx)
+{
+    struct PARTITION* part = &partArray[partIdx];
+    size_t mapWords = (part->clusterCount + 0x1F) >> 5;
+
+    part->freeMap = (uint32_t*)mem_dynalloc(mapWords * sizeof(uint32_t));
+    mem_set(part->freeMap, 0, mapWords * sizeof(uint32_t));
+    part->freeClusters = 0;
+
+    // Clusters 0 and 1 are reserved, so they're never marked as free
+    for (uint32_t clustIdx = 2; clustIdx < part->clusterCount; clustIdx++)
+    {
+        if (!part->fat[clustIdx])
+        {
+            part->freeMap[clustIdx >> 5] |= 1U << (clustIdx & 0x1F);
+            part->freeClusters++;
+        }
+    }
+
+    part->nextFree = 2;
+    part->fsInfoDirty = false;
+
+    // The FSInfo sector lies in the reserved area, 0 means there is none
+    if (!part->fsInfoSector || part->fsInfoSector >= part->reservedSectors)
+    {
+        part->fsInfoSector = 0;
+        return;
+    }
+
+    struct FSINFO* fsinfo = (struct FSINFO*)hddRead(part->hddIdx, part->lbaBegin + part->fsInfoSector);
+
+    // The free cluster count from the bitmap is still correct, only the hint is lost
+    if (!fsinfo)
+    {
+        debug_print("fat_dir.c | loadFreeMap() | Unable to read the FSInfo sector!");
+        part->fsInfoSector = 0;
+        return;
+    }
+
+    if (fsinfo->leadSignature != FSINFO_LEAD_SIGNATURE || fsinfo->structSignature != FSINFO_STRUCT_SIGNATURE)
+    {
+        debug_print("fat_dir.c | loadFreeMap() | Invalid FSInfo sector signature!");
+        part->fsInfoSector = 0;
+    }
+    else
+    {
+        // The hint is only a hint, the bitmap decides whether the cluster is actually free
+        if (fsinfo->nextFree >= 2 && fsinfo->nextFree < part->clusterCount)
+        {
+            part->nextFree = fsinfo->nextFree;
+        }
+
+        // The count stored on the disk may be unknown or outdated, the one from the bitmap is always correct
+        part->fsInfoDirty = (fsinfo->freeClusters != part->freeClusters);
+    }
+
+    mem_free(fsinfo);
+}
+
+bool fatLoad(const uint8_t partIdx)
 {
     // Calculate the sector offset
     size_t fatBegin = partArray[partIdx].lbaBegin + partArray[partIdx].reservedSectors;
+    size_t fatSectors = partArray[partIdx].fatSectors;
+    size_t dataBegin = partArray[partIdx].reservedSectors + (FAT_COUNT * fatSectors);
+
+    if (!partArray[partIdx].sectorsPerCluster || partArray[partIdx].sectorCount <= dataBegin)
+    {
+        debug_print("fat_dir.c | fatLoad() | Invalid partition layout!");
+        return false;
+    }
+
+    // The last FAT sector may have entries for clusters past the end of the partition, those can't be used
+    partArray[partIdx].clusterCount = ((partArray[partIdx].sectorCount - dataBegin) / partArray[partIdx].sectorsPerCluster) + 2;
+    if (partArray[partIdx].clusterCount > fatSectors * 0x80)
+    {
+        partArray[partIdx].clusterCount = fatSectors * 0x80;
+    }
+
+    // The whole FAT is read by a single transfer
+    partArray[partIdx].fat = (uint32_t*)mem_dynalloc(fatSectors * BYTES_PER_SECTOR);
+    partArray[partIdx].fatDirty = (uint32_t*)mem_dynalloc(((fatSectors + 0x1F) >> 5) * sizeof(uint32_t));
+    mem_set(partArray[partIdx].fatDirty, 0, ((fatSectors + 0x1F) >> 5) * sizeof(uint32_t));
+
+    if (!hddReadInto(partArray[partIdx].hddIdx, fatBegin, fatSectors, (uint8_t*)partArray[partIdx].fat))
+    {
+        debug_print("fat_dir.c | fatLoad() | Unable to read the FAT!");
+
+        mem_free(partArray[partIdx].fat);
+        mem_free(partArray[partIdx].fatDirty);
+        partArray[partIdx].fat = (uint32_t*)0;
+        partArray[partIdx].fatDirty = (uint32_t*)0;
+        return false;
+    }
+
+    loadFreeMap(partIdx);
+    return true;
+}
 
-    // There are 128 FAT entries in each sector
-    size_t secIdx = fatBegin + (clustIdx / 0x80);
-    size_t entryIdx = clustIdx % 0x80;
+void fatWrite(const uint8_t partIdx, const uint32_t clustIdx, const uint32_t content)
+{
+    struct PARTITION* part = &partArray[partIdx];
+
+    if (clustIdx >= part->fatSectors * 0x80)
+    {
+        debug_print("fat_dir.c | fatWrite() | Cluster index is outside of the FAT!");
+        return;
+    }
+
+    // Cached cluster chains may go through the modified entry
+    if (part->fat[clustIdx] != content)
+    {
+        part->fatGeneration++;
+    }
+
+    // Keep the free cluster bitmap in sync with the FAT
+    if (clustIdx >= 2 && clustIdx < part->clusterCount && !part->fat[clustIdx] != !content)
+    {
+        if (content)
+        {
+            part->freeMap[clustIdx >> 5] &= ~(1U << (clustIdx & 0x1F));
+            part->freeClusters--;
+
+            // Next-fit, the next search begins right after the allocated cluster
+            part->nextFree = (clustIdx + 1 < part->clusterCount ? clustIdx + 1 : 2);
+        }
+        else
+        {
+            part->freeMap[clustIdx >> 5] |= 1U << (clustIdx & 0x1F);
+            part->freeClusters++;
+        }
 
-    // Read the old FAT sector
-    struct FAT_TABLE* fat = (struct FAT_TABLE*)hddRead(partArray[partIdx].hddIdx, secIdx);
+        part->fsInfoDirty = true;
+    }
 
     // Change the content of a specified entry
-    fat->entries[entryIdx] = content;
+    part->fat[clustIdx] = content;
+
+    // There are 128 FAT entries in each sector, the sector has to be written to the disk later
+    size_t secIdx = clustIdx / 0x80;
+    part->fatDirty[secIdx >> 5] |= 1U << (secIdx & 0x1F);
+}
+
+bool fatFlush(const uint8_t partIdx)
+{
+    size_t fatBegin = partArray[partIdx].lbaBegin + partArray[partIdx].reservedSectors;
+    size_t fatSectors = partArray[partIdx].fatSectors;
+    uint32_t* dirty = partArray[partIdx].fatDirty;
+
+    bool success = true;
+
+    for (size_t secIdx = 0; secIdx < fatSectors; )
+    {
+        // Skip 32 clean sectors at once
+        if (!dirty[secIdx >> 5])
+        {
+            secIdx = (secIdx | 0x1F) + 1;
+            continue;
+        }
+
+        if (!(dirty[secIdx >> 5] & (1U << (secIdx & 0x1F))))
+        {
+            secIdx++;
+            continue;
+        }
+
+        // Consecutive modified sectors are written together
+        size_t runEnd = secIdx;
+        while (runEnd < fatSectors && (dirty[runEnd >> 5] & (1U << (runEnd & 0x1F))))
+        {
+            dirty[runEnd >> 5] &= ~(1U << (runEnd & 0x1F));
+            runEnd++;
+        }
+
+        // Every copy of the FAT has to be kept identical
+        for (size_t copy = 0; copy < FAT_COUNT; copy++)
+        {
+            if (!hddWriteFrom(partArray[partIdx].hddIdx, fatBegin + (copy * fatSectors) + secIdx, runEnd - secIdx,
+                (const uint8_t*)&partArray[partIdx].fat[secIdx * 0x80]))
+            {
+                debug_print("fat_dir.c | fatFlush() | Unable to write a FAT sector!");
+                success = false;
+            }
+        }
+
+        secIdx = runEnd;
+    }
+
+    // Store the free cluster count and the next free cluster hint in the FSInfo sector
+    if (partArray[partIdx].fsInfoDirty && partArray[partIdx].fsInfoSector)
+    {
+        uint64_t fsinfoSector = partArray[partIdx].lbaBegin + partArray[partIdx].fsInfoSector;
+        struct FSINFO* fsinfo = (struct FSINFO*)mem_dynalloc(sizeof(struct FSINFO));
+
+        if (hddReadInto(partArray[partIdx].hddIdx, fsinfoSector, 1, (uint8_t*)fsinfo))
+        {
+            fsinfo->freeClusters = partArray[partIdx].freeClusters;
+            fsinfo->nextFree = partArray[partIdx].nextFree;
+
+            if (hddWriteFrom(partArray[partIdx].hddIdx, fsinfoSector, 1, (const uint8_t*)fsinfo))
+            {
+                partArray[partIdx].fsInfoDirty = false;
+            }
+        }
+
+        if (partArray[partIdx].fsInfoDirty)
+        {
+            debug_print("fat_dir.c | fatFlush() | Unable to update the FSInfo sector!");
+            success = false;
+        }
 
-    // Write the new FAT sector with the modified entry
-    hddWrite(partArray[partIdx].hddIdx, secIdx, (uint8_t*)fat);
+        mem_free(fsinfo);
+    }
 
-    mem_free(fat);
+    return success;
 }
 
-bool prolongClusterChain(const uint8_t partIdx, const uint32_t firstClust, const size_t clustCount)
+// Returns the number of consecutive free clusters beginning at clustIdx, but at most limit
+static uint32_t freeRunLength(const uint32_t* const freeMap, const uint32_t clustIdx, const uint32_t end, const uint32_t limit)
 {
-    if (!clustCount)
+    uint32_t runEnd = clustIdx;
+
+    while (runEnd < end && runEnd - clustIdx < limit)
     {
-        debug_print("fat_dir.c | prolongClusterChain() | It's redundant to prolong a cluster chain by 0 clusters!");
-        return true; // It was technically successful despite not doing anything
+        // Skip whole words of free clusters at once
+        if (!(runEnd & 0x1F) && freeMap[runEnd >> 5] == 0xFFFFFFFF && end - runEnd >= 0x20)
+        {
+            runEnd += 0x20;
+        }
+        else if (freeMap[runEnd >> 5] & (1U << (runEnd & 0x1F)))
+        {
+            runEnd++;
+        }
+        else
+        {
+            break;
+        }
     }
 
-    // Get the cluster chain beginning at the specified cluster
-    uint32_t* clusterChain = getClusterChain(partIdx, firstClust);
+    return (runEnd - clustIdx < limit ? runEnd - clustIdx : limit);
+}
 
-    // Get the last cluster in the chain
-    uint32_t lastCluster = 0;
-    for (size_t i = 0; clusterChain[i] < CLUSTER_CHAIN_TERMINATOR; i++)
+// Finds the first run of at least count free clusters, beginning at the next free cluster hint
+// If there is no such run, the longest run found is returned instead, returns the length of the run
+static uint32_t findFreeRun(const uint8_t partIdx, const uint32_t count, uint32_t* const runStart)
+{
+    struct PARTITION* part = &partArray[partIdx];
+
+    uint32_t bestStart = 0;
+    uint32_t bestLength = 0;
+
+    // The partition is searched from the hint to its end and then from its beginning to the hint
+    uint32_t passBegin[2] = { part->nextFree, 2 };
+    uint32_t passEnd[2] = { part->clusterCount, part->nextFree };
+
+    for (size_t pass = 0; pass < 2; pass++)
+    {
+        uint32_t clustIdx = passBegin[pass];
+
+        while ((clustIdx = findFreeInMap(part->freeMap, clustIdx, passEnd[pass])))
+        {
+            uint32_t length = freeRunLength(part->freeMap, clustIdx, passEnd[pass], count);
+
+            if (length > bestLength)
+            {
+                bestStart = clustIdx;
+                bestLength = length;
+
+                if (length == count)
+                {
+                    break;
+                }
+            }
+
+            clustIdx += length;
+        }
+
+        if (bestLength == count)
+        {
+            break;
+        }
+    }
+
+    *runStart = bestStart;
+    return bestLength;
+}
+
+uint32_t allocateClusterChain(const uint8_t partIdx, const uint32_t lastClust, const size_t clustCount)
+{
+    struct PARTITION* part = &partArray[partIdx];
+
+    // Make sure the whole chain fits before the FAT is modified
+    if (!clustCount || clustCount > part->freeClusters)
     {
-        lastCluster = clusterChain[i];
+        debug_print("fat_dir.c | allocateClusterChain() | Not enough empty clusters!");
+        return 0;
     }
 
-    mem_free(clusterChain);
+    uint32_t firstClust = 0;
+    uint32_t prevClust = lastClust;
+    uint32_t remaining = clustCount;
 
-    for (size_t i = 0; i < clustCount; i++)
+    while (remaining)
     {
-        // Find an empty cluster to add to the chain
-        size_t emptyCluster = findEmptyCluster(partIdx);
+        uint32_t runStart = 0;
+        uint32_t runLength = 0;
 
-        // Valid clusters always have an index of 2 or higher
-        if (emptyCluster < 2)
+        // A chain is preferably continued by the clusters right after its last cluster
+        if (prevClust && prevClust + 1 < part->clusterCount)
         {
-            debug_print("fat_dir.c | prolongClusterChain() | Invalid empty cluster index!");
-            mem_free(clusterChain);
-            return false;
+            runStart = prevClust + 1;
+            runLength = freeRunLength(part->freeMap, runStart, part->clusterCount, remaining);
+        }
+
+        if (!runLength)
+        {
+            runLength = findFreeRun(partIdx, remaining, &runStart);
+        }
+
+        // The free cluster count says there are enough clusters, so this should never happen
+        if (!runLength)
+        {
+            debug_print("fat_dir.c | allocateClusterChain() | Free cluster bitmap is inconsistent!");
+            break;
+        }
+
+        if (!firstClust)
+        {
+            firstClust = runStart;
+        }
+
+        // Link the run to the end of the chain and each of its clusters to the next one
+        if (prevClust)
+        {
+            fatWrite(partIdx, prevClust, runStart);
         }
 
-        // Append the empty cluster to the end of the cluster chain
-        fatWrite(partIdx, lastCluster, emptyCluster);
+        for (uint32_t clustIdx = runStart; clustIdx < runStart + runLength - 1; clustIdx++)
+        {
+            fatWrite(partIdx, clustIdx, clustIdx + 1);
+        }
+
+        prevClust = runStart + runLength - 1;
+        fatWrite(partIdx, prevClust, CLUSTER_CHAIN_TERMINATOR);
+
+        remaining -= runLength;
+    }
+
+    // All the modified entries are written to the disk at once
+    fatFlush(partIdx);
+
+    return (remaining ? 0 : firstClust);
+}
+
+bool prolongClusterChain(const uint8_t partIdx, const uint32_t firstClust, const size_t clustCount)
+{
+    if (!clustCount)
+    {
+        debug_print("fat_dir.c | prolongClusterChain() | It's redundant to prolong a cluster chain by 0 clusters!");
+        return true; // It was technically successful despite not doing anything
+    }
+
+    // The last cluster of the chain is at the end of its last extent
+    size_t extentCount = 0;
+    const struct CLUSTER_EXTENT* extents = cachedExtents(partIdx, firstClust, &extentCount);
+
+    if (!extentCount)
+    {
+        debug_print("fat_dir.c | prolongClusterChain() | The cluster chain is empty!");
+        return false;
+    }
 
-        // Mark the end of the chain by writing the terminator to the last cluster entry in the chain
-        // This must be done every time, otherwise the last cluster entry will contain 0 and thus it will be considered as empty
-        // and the findEmptyCluster() function will keep finding it over and over and it won't know it's already in the chain
-        fatWrite(partIdx, emptyCluster, CLUSTER_CHAIN_TERMINATOR);
+    uint32_t lastCluster = extents[extentCount - 1].start + extents[extentCount - 1].length - 1;
 
-        // The cluster we've just appended to the chain is now the last cluster in the chain
-        lastCluster = emptyCluster;
+    if (!allocateClusterChain(partIdx, lastCluster, clustCount))
+    {
+        debug_print("fat_dir.c | prolongClusterChain() | Unable to allocate the clusters!");
+        return false;
     }
 
     return true;
@@ -189,17 +616,17 @@ bool shortenClusterChain(const uint8_t partIdx, const uint32_t firstClust, const
     }
 
     // Count down clusters starting from the end
-    for (size_t i = 0; i < clustCount; i++)
+    for (size_t i = 1; i <= clustCount; i++)
     {
         // Set the cluster as unused
         fatWrite(partIdx, clusterChain[chainlen - i], 0);
     }
 
     // Mark the end of the chain by writing the terminator to the last entry in the chain
-    fatWrite(partIdx, clusterChain[chainlen - clustCount], CLUSTER_CHAIN_TERMINATOR);
+    fatWrite(partIdx, clusterChain[chainlen - clustCount - 1], CLUSTER_CHAIN_TERMINATOR);
 
     mem_free(clusterChain);
-    return true;
+    return fatFlush(partIdx);
 }
 
 char* fileNameToString(const char* const fileName)
@@ -253,10 +680,18 @@ char* fileNameToString(const char* const fileName)
     return strName;
 }
 
-void stringToFileName(const char* const strSrc, char* const fileNameDst)
+bool stringToFileName(const char* const strSrc, char* const fileNameDst)
 {
-    // Writing starts at the index 0
+    // "." and ".." entries are stored as names without an extension
+    if (strcmp(strSrc, ".") || strcmp(strSrc, ".."))
+    {
+        stringToFileNameNoExt(strSrc, fileNameDst);
+        return true;
+    }
+
+    // Writing starts at the index 0, the name part ends at the index 8 and the extension at the index 11
     size_t offset = 0;
+    size_t limit = 8;
 
     // Clear the file name
     for (size_t i = 0; i < 11; i++)
@@ -271,7 +706,19 @@ void stringToFileName(const char* const strSrc, char* const fileNameDst)
         // The '.' character itself is not gonna be part of the name
         if (strSrc[i] == '.')
         {
+            // There can only be a single extension
+            if (limit == 11)
+            {
+                return false;
+            }
+
             offset = 8;
+            limit = 11;
+        }
+        // Either the name or the extension is too long
+        else if (offset >= limit)
+        {
+            return false;
         }
         else
         {
@@ -280,6 +727,8 @@ void stringToFileName(const char* const strSrc, char* const fileNameDst)
             fileNameDst[offset++] = ctoupper(strSrc[i]);
         }
     }
+
+    return true;
 }
 
 void stringToFileNameNoExt(const char* const strSrc, char* const fileNameDst)
@@ -314,6 +763,9 @@ void listDirectory(const uint8_t partIdx, const uint32_t dirFirstClust)
     bool endOfDir = false;
     size_t chainIdx = 0;
 
+    // A single sector buffer is reused for the whole directory
+    struct DIR_SECTOR* dirsec = (struct DIR_SECTOR*)mem_dynalloc(sizeof(struct DIR_SECTOR));
+
     // Go through each cluster in the cluster chain
     while (clusterChain[chainIdx] < CLUSTER_CHAIN_TERMINATOR && !endOfDir)
     {
@@ -324,7 +776,12 @@ void listDirectory(const uint8_t partIdx, const uint32_t dirFirstClust)
         for (size_t iSec = 0; iSec < partArray[partIdx].sectorsPerCluster && !endOfDir; iSec++)
         {
             // Read the directory sector from disk
-            struct DIR_SECTOR* dirsec = (struct DIR_SECTOR*)hddRead(partArray[partIdx].hddIdx, clusterBase + iSec);
+            if (!hddReadInto(partArray[partIdx].hddIdx, clusterBase + iSec, 1, (uint8_t*)dirsec))
+            {
+                term_writeline("Unable to read the directory!", false);
+                endOfDir = true;
+                break;
+            }
 
             // Go through each of the 16 entries in the directory sector
             for (size_t iEntry = 0; iEntry < 16 && !endOfDir; iEntry++)
@@ -363,11 +820,10 @@ void listDirectory(const uint8_t partIdx, const uint32_t dirFirstClust)
                     }
                 }
             }
-
-            mem_free(dirsec);
         }
     }
 
+    mem_free(dirsec);
     mem_free(clusterChain);
 }
 
@@ -389,7 +845,8 @@ uint32_t resolvePath(const uint8_t partIdx, const uint32_t baseDir, const char*
 
     for (size_t i = 0; i < pathsize; i++)
     {
-        if (path[i] != '/')
+        // Longer names are cut off, they're still too long to be valid 8.3 names
+        if (path[i] != '/' && stridx < sizeof(strsearch) - 1)
         {
             // Copy each directory name in the path in lowercase
             strsearch[stridx++] = ctolower(path[i]);
@@ -455,7 +912,9 @@ size_t findUnusedDirEntry(const uint8_t partIdx, const uint32_t baseDir)
     size_t chainIdx = 0;
 
     bool writeEndOfDir = false;
-    size_t unusedDirEntryIdx = 0;    
+    size_t unusedDirEntryIdx = 0;
+
+    struct DIR_SECTOR* dirsec = (struct DIR_SECTOR*)mem_dynalloc(sizeof(struct DIR_SECTOR));
 
     // Search through the cluster chain until the end of the directory is reached
     while (clusterChain[chainIdx] < CLUSTER_CHAIN_TERMINATOR)
@@ -467,7 +926,16 @@ size_t findUnusedDirEntry(const uint8_t partIdx, const uint32_t baseDir)
         for (size_t iSec = 0; iSec < partArray[partIdx].sectorsPerCluster; iSec++)
         {
             // Read the sector from the drive
-            struct DIR_SECTOR* dirsec = (struct DIR_SECTOR*)hddRead(partArray[partIdx].hddIdx, clusterBase + iSec);
+            // The buffer would still hold the previous sector, writing it back would overwrite this one
+            if (!hddReadInto(partArray[partIdx].hddIdx, clusterBase + iSec, 1, (uint8_t*)dirsec))
+            {
+                debug_print("fat_dir.c | findUnusedDirEntry() | Unable to read a directory sector!");
+
+                mem_free(dirsec);
+                mem_free(clusterChain);
+
+                return 0;
+            }
 
             // Look through all the entries in the sector
             for (size_t iEntry = 0; iEntry < 0x10; iEntry++)
@@ -538,11 +1006,10 @@ size_t findUnusedDirEntry(const uint8_t partIdx, const uint32_t baseDir)
                     }
                 }
             }
-
-            mem_free(dirsec);
         }
     }
 
+    mem_free(dirsec);
     mem_free(clusterChain);
 
     // Should be unreachable
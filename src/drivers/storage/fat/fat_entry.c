@@ -5,13 +5,57 @@
 #include <drivers/io/terminal.h>
 #include <kernel.h>
 
+// Returns a copy of the directory entry if it has the requested attributes
+static struct DIR_ENTRY* returnEntry(const struct DIR_ENTRY* const entry, const uint8_t attribMask, const uint8_t attrib)
+{
+    // There can only be one entry with the name, so if its attributes don't match, the search has failed
+    if (!attribCheck(entry->attrib, attribMask, attrib))
+    {
+        debug_print("fat_entry.c | findEntry() | Entry doesn't have the requested attributes!");
+        return (struct DIR_ENTRY*)0;
+    }
+
+    // The copy is only needed until the caller is done with it, a memory region can take care of it
+    struct DIR_ENTRY* direntry = mem_regionalloc(sizeof(struct DIR_ENTRY));
+    mem_copy(entry, direntry, sizeof(struct DIR_ENTRY));
+
+    return direntry;
+}
+
 struct DIR_ENTRY* findEntry(const uint8_t partIdx, const uint32_t baseDirCluster, const char* const name, const uint8_t attribMask, const uint8_t attrib)
 {
+    // The name is converted only once, entries are then compared in the format they're stored in
+    char fileName[11];
+
+    if (!stringToFileName(name, fileName))
+    {
+        debug_print("fat_entry.c | findEntry() | Name isn't a valid 8.3 file name!");
+        return (struct DIR_ENTRY*)0;
+    }
+
+    // Names that have been searched for recently don't require reading the directory
+    struct DIR_ENTRY cachedEntry;
+    bool cachedFound = false;
+
+    if (dcacheLookup(partIdx, baseDirCluster, fileName, &cachedFound, &cachedEntry))
+    {
+        if (cachedFound)
+        {
+            return returnEntry(&cachedEntry, attribMask, attrib);
+        }
+
+        debug_print("fat_entry.c | findEntry() | Entry couldn't be found!");
+        return (struct DIR_ENTRY*)0;
+    }
+
     // Get cluster chain
     uint32_t* clusterChain = getClusterChain(partIdx, baseDirCluster);
 
     bool endOfDir = false;
 
+    // A single sector buffer is reused for the whole directory
+    struct DIR_SECTOR* dirsec = (struct DIR_SECTOR*)mem_dynalloc(sizeof(struct DIR_SECTOR));
+
     // Search through the cluster chain until the end of the directory is reached
     for (size_t chainIdx = 0; clusterChain[chainIdx] < CLUSTER_CHAIN_TERMINATOR && !endOfDir; chainIdx++)
     {
@@ -22,7 +66,16 @@ struct DIR_ENTRY* findEntry(const uint8_t partIdx, const uint32_t baseDirCluster
         for (size_t iSec = 0; iSec < partArray[partIdx].sectorsPerCluster && !endOfDir; iSec++)
         {
             // Read the sector from the drive
-            struct DIR_SECTOR* dirsec = (struct DIR_SECTOR*)hddRead(partArray[partIdx].hddIdx, clusterBase + iSec);
+            // The rest of the directory is unknown, so a missing entry mustn't be cached as nonexistent
+            if (!hddReadInto(partArray[partIdx].hddIdx, clusterBase + iSec, 1, (uint8_t*)dirsec))
+            {
+                debug_print("fat_entry.c | findEntry() | Unable to read a directory sector!");
+
+                mem_free(dirsec);
+                mem_free(clusterChain);
+
+                return (struct DIR_ENTRY*)0;
+            }
 
             // Look through all the entries in the sector
             for (size_t iEntry = 0; iEntry < 0x10 && !endOfDir; iEntry++)
@@ -37,18 +90,13 @@ struct DIR_ENTRY* findEntry(const uint8_t partIdx, const uint32_t baseDirCluster
                     endOfDir = true;
                 }
                 else if (entryFirstByte != DIR_ENTRY_UNUSED && // mustn't be an unused entry
-                    dirsec->entries[iEntry].attrib != FILE_ATTRIB_LONG_NAME && // mustn't be a long name entry
-                    attribCheck(dirsec->entries[iEntry].attrib, attribMask, attrib)) // check attributes
+                    dirsec->entries[iEntry].attrib != FILE_ATTRIB_LONG_NAME) // mustn't be a long name entry
                 {
-                    char* strName = fileNameToString(&dirsec->entries[iEntry].fileName[0]);
-                    bool namesMatch = strcmp(name, strName);
-                    mem_free(strName);
-
-                    // Names match, return the directory entry
-                    if (namesMatch)
+                    // Names match, the attributes are checked only after the entry is cached
+                    if (fileNameEqual(dirsec->entries[iEntry].fileName, fileName))
                     {
-                        struct DIR_ENTRY* direntry = mem_dynalloc(sizeof(struct DIR_ENTRY));
-                        mem_copy(&dirsec->entries[iEntry], direntry, sizeof(struct DIR_ENTRY));
+                        dcacheInsert(partIdx, baseDirCluster, fileName, &dirsec->entries[iEntry]);
+                        struct DIR_ENTRY* direntry = returnEntry(&dirsec->entries[iEntry], attribMask, attrib);
 
                         mem_free(dirsec);
                         mem_free(clusterChain);
@@ -58,12 +106,15 @@ struct DIR_ENTRY* findEntry(const uint8_t partIdx, const uint32_t baseDirCluster
                 }
             }
 
-            mem_free(dirsec);
         }
     }
 
+    mem_free(dirsec);
     mem_free(clusterChain);
 
+    // Remember that the name doesn't exist, so that looking for it again doesn't require reading the directory
+    dcacheInsert(partIdx, baseDirCluster, fileName, (struct DIR_ENTRY*)0);
+
     // Entry not found, return nullptr
     debug_print("fat_entry.c | findEntry() | Entry couldn't be found!");
     return (struct DIR_ENTRY*)0;
@@ -142,9 +193,9 @@ uint8_t* readFile(const struct FILE* const file)
         return (uint8_t*)0;
     }
 
-    uint32_t* clusterChain = getClusterChain(file->partIdx, file->cluster);
+    struct CLUSTER_EXTENT* extents = getClusterExtents(file->partIdx, file->cluster);
 
-    if (!clusterChain)
+    if (!extents)
     {
         debug_print("fat_entry.c | readFile() | Couldn't get the cluster chain!");
         return (uint8_t*)0;
@@ -153,37 +204,61 @@ uint8_t* readFile(const struct FILE* const file)
     // Allocate memory space for the file content
     uint8_t* fileContent = mem_dynalloc(file->size + 1); // used to store the contents of the file
     size_t contentIdx = 0;
-    bool fileEnd = false;
 
-    // Reach all clusters that belong to this file
-    for (size_t i = 0; clusterChain[i] < CLUSTER_CHAIN_TERMINATOR && !fileEnd; i++)
+    // Reach all clusters that belong to this file, each extent of consecutive clusters is read at once
+    for (size_t i = 0; extents[i].length && contentIdx < file->size; i++)
     {
-        // Calculate the index of the first sector of the cluster
-        uint64_t clusterBase = clusterToSector(file->partIdx, clusterChain[i]);
+        // Calculate the index of the first sector of the extent
+        uint64_t clusterBase = clusterToSector(file->partIdx, extents[i].start);
+        size_t runSectors = extents[i].length * partArray[file->partIdx].sectorsPerCluster;
 
-        // Go through all the sectors in the cluster
-        for (size_t j = 0; j < partArray[file->partIdx].sectorsPerCluster && !fileEnd; j++)
+        // Sectors that are fully occupied by the file are read straight into the file content
+        size_t fullSectors = (file->size - contentIdx) >> 9;
+        if (fullSectors > runSectors)
         {
-            // Read a sector of the file content from the disk
-            uint8_t* data = hddRead(partArray[file->partIdx].hddIdx, clusterBase + j);
+            fullSectors = runSectors;
+        }
 
-            // If the file does not occupy the whole sector copy only as much as necessary
-            // This also means the end of file has been reached
-            size_t readlen = 0x200;
-            if (contentIdx + readlen > file->size)
+        if (fullSectors)
+        {
+            if (!hddReadInto(partArray[file->partIdx].hddIdx, clusterBase, fullSectors, &fileContent[contentIdx]))
             {
-                readlen = file->size - contentIdx;
-                fileEnd = true;
+                debug_print("fat_entry.c | readFile() | Unable to read the file content!");
+
+                mem_free(fileContent);
+                mem_free(extents);
+
+                return (uint8_t*)0;
             }
 
-            mem_copy(data, &fileContent[contentIdx], readlen);
-            contentIdx += readlen;
+            contentIdx += fullSectors << 9;
+        }
+
+        // If the file does not occupy the whole last sector copy only as much as necessary
+        // The sector can't be read into the file content directly, because it would overflow the buffer
+        if (fullSectors < runSectors && contentIdx < file->size)
+        {
+            uint8_t* data = mem_dynalloc(0x200);
+
+            if (!hddReadInto(partArray[file->partIdx].hddIdx, clusterBase + fullSectors, 1, data))
+            {
+                debug_print("fat_entry.c | readFile() | Unable to read the file content!");
+
+                mem_free(data);
+                mem_free(fileContent);
+                mem_free(extents);
+
+                return (uint8_t*)0;
+            }
+
+            mem_copy(data, &fileContent[contentIdx], file->size - contentIdx);
+            contentIdx = file->size;
 
             mem_free(data);
         }
     }
 
-    mem_free(clusterChain);
+    mem_free(extents);
 
     // Used to avoid having to copy the whole file's content when creating a string object from it
     fileContent[file->size] = '\0';
@@ -193,6 +268,14 @@ uint8_t* readFile(const struct FILE* const file)
 
 struct FILE* newEntry(const uint8_t partIdx, const uint32_t baseDir, const char* const name, const uint8_t attrib, const uint32_t size)
 {
+    // Names that don't fit into a directory entry are rejected before anything is allocated
+    char fileName[11];
+    if (!stringToFileName(name, fileName))
+    {
+        term_writeline("Invalid file name!", false);
+        return (struct FILE*)0;
+    }
+
 	struct DIR_ENTRY* existingEntry = findEntry(partIdx, baseDir, name, 0, 0);
 	if (existingEntry)
 	{
@@ -218,20 +301,8 @@ struct FILE* newEntry(const uint8_t partIdx, const uint32_t baseDir, const char*
     size_t entryIdx = unusedIdx & 0xF;
     size_t secIdx = clusterToSector(partIdx, 0) + (unusedIdx >> 4);
 
-    // How many clusters are used by the entry
-	size_t clusterCount = bytesToClusterCount(partIdx, size);	
-	// Find the first cluster for the file
-	uint32_t firstCluster = findEmptyCluster(partIdx);
-    // Set the first cluster as the last cluster
-    fatWrite(partIdx, firstCluster, CLUSTER_CHAIN_TERMINATOR);
-
-    // Prolong the cluster chain if necessary
-    if (clusterCount > 1)
-    {
-        prolongClusterChain(partIdx, firstCluster, clusterCount - 1);
-    }
-
     // Read old directory entries from the sector
+    // It's read before the clusters are allocated, so a failed read doesn't leave them unreferenced
     struct DIR_SECTOR* dirsec = (struct DIR_SECTOR*)hddRead(partArray[partIdx].hddIdx, secIdx);
     if (!dirsec)
     {
@@ -239,8 +310,24 @@ struct FILE* newEntry(const uint8_t partIdx, const uint32_t baseDir, const char*
         return (struct FILE*)0;
     }
 
+    // How many clusters are used by the entry, even an empty entry occupies a cluster
+	size_t clusterCount = bytesToClusterCount(partIdx, size);
+    if (!clusterCount)
+    {
+        clusterCount = 1;
+    }
+
+	// The final size is known, so the whole cluster chain is allocated at once, preferably unfragmented
+	uint32_t firstCluster = allocateClusterChain(partIdx, 0, clusterCount);
+    if (!firstCluster)
+    {
+        mem_free(dirsec);
+        term_writeline("Not enough free space!", false);
+        return (struct FILE*)0;
+    }
+
     // Write the file information into the proper directory entry
-    stringToFileName(name, &dirsec->entries[entryIdx].fileName[0]);
+    mem_copy(fileName, &dirsec->entries[entryIdx].fileName[0], sizeof(fileName));
     dirsec->entries[entryIdx].attrib = attrib;
     dirsec->entries[entryIdx].clusterHigh = (uint16_t)(firstCluster >> 0x10);
     dirsec->entries[entryIdx].clusterLow = (uint16_t)firstCluster;
@@ -248,6 +335,10 @@ struct FILE* newEntry(const uint8_t partIdx, const uint32_t baseDir, const char*
 
     hddWrite(partArray[partIdx].hddIdx, secIdx, (uint8_t*)dirsec);
 
+    // The name may be cached as missing and the clusters may have belonged to a deleted directory
+    dcacheInvalidate(partIdx, baseDir, fileName);
+    dcacheInvalidateDir(partIdx, firstCluster);
+
     mem_free(dirsec);
 
     // Generate the FILE structure
@@ -329,6 +420,8 @@ struct FILE* newDir(const uint8_t partIdx, const uint32_t baseDir, const char* c
 	
 	// Allocate memory space to store the generated directory sector
 	struct DIR_SECTOR* dirsec = (struct DIR_SECTOR*)mem_dynalloc(0x200);
+	// Allocated memory isn't zeroed, the unused fields of the entries must be cleared
+	mem_set(dirsec, 0, 0x200);
 	
 	// First entry points to the directory itself
     // Standard stringToFileName() wouldn't allow us to write dots in the file name
@@ -356,6 +449,10 @@ struct FILE* newDir(const uint8_t partIdx, const uint32_t baseDir, const char* c
 	return dir;
 }
 
+// Names of the "." and ".." entries in the FAT format
+static const char FILE_NAME_DOT[]    = ".          ";
+static const char FILE_NAME_DOTDOT[] = "..         ";
+
 bool dirIsEmpty(const uint8_t partIdx, const uint32_t dirFirstClust)
 {
     // Get cluster chain
@@ -363,6 +460,8 @@ bool dirIsEmpty(const uint8_t partIdx, const uint32_t dirFirstClust)
 
     bool endOfDir = false;
 
+    struct DIR_SECTOR* dirsec = (struct DIR_SECTOR*)mem_dynalloc(sizeof(struct DIR_SECTOR));
+
     // Search through the cluster chain until the end of the directory is reached
     for (size_t chainIdx = 0; clusterChain[chainIdx] < CLUSTER_CHAIN_TERMINATOR && !endOfDir; chainIdx++)
     {
@@ -373,7 +472,16 @@ bool dirIsEmpty(const uint8_t partIdx, const uint32_t dirFirstClust)
         for (size_t iSec = 0; iSec < partArray[partIdx].sectorsPerCluster && !endOfDir; iSec++)
         {
             // Read the sector from the drive
-            struct DIR_SECTOR* dirsec = (struct DIR_SECTOR*)hddRead(partArray[partIdx].hddIdx, clusterBase + iSec);
+            // An unread sector may contain entries, so the directory can't be considered empty
+            if (!hddReadInto(partArray[partIdx].hddIdx, clusterBase + iSec, 1, (uint8_t*)dirsec))
+            {
+                debug_print("fat_entry.c | dirIsEmpty() | Unable to read a directory sector!");
+
+                mem_free(dirsec);
+                mem_free(clusterChain);
+
+                return false;
+            }
 
             // Look through all the entries in the sector
             for (size_t iEntry = 0; iEntry < 0x10 && !endOfDir; iEntry++)
@@ -390,9 +498,8 @@ bool dirIsEmpty(const uint8_t partIdx, const uint32_t dirFirstClust)
                 else if (entryFirstByte != DIR_ENTRY_UNUSED && // mustn't be an unused entry
                     dirsec->entries[iEntry].attrib != FILE_ATTRIB_LONG_NAME) // mustn't be a long name entry
                 {
-                    char* strName = fileNameToString(&dirsec->entries[iEntry].fileName[0]);
-                    bool validEntry = !strcmp(".", strName) && !strcmp("..", strName); // "." and ".." aren't real entries
-                    mem_free(strName);
+                    bool validEntry = !fileNameEqual(dirsec->entries[iEntry].fileName, FILE_NAME_DOT) &&
+                        !fileNameEqual(dirsec->entries[iEntry].fileName, FILE_NAME_DOTDOT); // "." and ".." aren't real entries
 
                     // This directory contains a valid entry
                     // That means it can't be safely deleted
@@ -407,10 +514,10 @@ bool dirIsEmpty(const uint8_t partIdx, const uint32_t dirFirstClust)
                 }
             }
 
-            mem_free(dirsec);
         }
     }
 
+    mem_free(dirsec);
     mem_free(clusterChain);
 
     // Directory is empty
@@ -437,6 +544,15 @@ bool deleteEntry(const uint8_t partIdx, const uint32_t baseDir, const char* cons
 		term_writeline("Invalid directory path!", false);
 		return false;
 	}
+
+    // The name is converted only once, entries are then compared in the format they're stored in
+    char fileName[11];
+    if (!stringToFileName(pathName, fileName))
+    {
+        mem_free(pathName);
+        term_writeline("Specified entry doesn't exist!", false);
+        return false;
+    }
 	
 	// -- Delete the directory entry
 	
@@ -448,6 +564,8 @@ bool deleteEntry(const uint8_t partIdx, const uint32_t baseDir, const char* cons
 	
 	uint32_t entryCluster = 0;
 
+    struct DIR_SECTOR* dirsec = (struct DIR_SECTOR*)mem_dynalloc(sizeof(struct DIR_SECTOR));
+
     // Search through the cluster chain until the end of the directory is reached
 	for (size_t i = 0; dircc[i] < CLUSTER_CHAIN_TERMINATOR && !endOfDir && !entryFound; i++)
     {
@@ -458,7 +576,17 @@ bool deleteEntry(const uint8_t partIdx, const uint32_t baseDir, const char* cons
         for (size_t iSec = 0; iSec < partArray[partIdx].sectorsPerCluster && !endOfDir && !entryFound; iSec++)
         {
             // Read the sector from the drive
-            struct DIR_SECTOR* dirsec = (struct DIR_SECTOR*)hddRead(partArray[partIdx].hddIdx, clusterBase + iSec);
+            // The buffer would still hold the previous sector, writing it back would overwrite this one
+            if (!hddReadInto(partArray[partIdx].hddIdx, clusterBase + iSec, 1, (uint8_t*)dirsec))
+            {
+                debug_print("fat_entry.c | deleteEntry() | Unable to read a directory sector!");
+
+                mem_free(dirsec);
+                mem_free(dircc);
+                mem_free(pathName);
+
+                return false;
+            }
 
             // Look through all the entries in the sector
             for (size_t iEntry = 0; iEntry < 0x10 && !endOfDir && !entryFound; iEntry++)
@@ -475,12 +603,8 @@ bool deleteEntry(const uint8_t partIdx, const uint32_t baseDir, const char* cons
                 else if (entryFirstByte != DIR_ENTRY_UNUSED && // mustn't be an unused entry
                     dirsec->entries[iEntry].attrib != FILE_ATTRIB_LONG_NAME) // mustn't be a long name entry
                 {
-                    char* strName = fileNameToString(&dirsec->entries[iEntry].fileName[0]);
-                    bool namesMatch = strcmp(pathName, strName);
-                    mem_free(strName);
-
                     // Names match, we've found the entry
-                    if (namesMatch)
+                    if (fileNameEqual(dirsec->entries[iEntry].fileName, fileName))
                     {
                         if (dirsec->entries[iEntry].attrib & FILE_ATTRIB_DIRECTORY &&
                             !dirIsEmpty(partIdx, joinCluster(dirsec->entries[iEntry].clusterHigh, dirsec->entries[iEntry].clusterLow)))
@@ -501,6 +625,10 @@ bool deleteEntry(const uint8_t partIdx, const uint32_t baseDir, const char* cons
 						// Write the modified directory sector to disk
 						hddWrite(partArray[partIdx].hddIdx, clusterBase + iSec, (uint8_t*)dirsec);
 
+                        // Neither the entry nor the content of a deleted directory may be found anymore
+                        dcacheInvalidate(partIdx, targetDir, fileName);
+                        dcacheInvalidateDir(partIdx, entryCluster);
+
                         mem_free(dircc);
 						mem_free(pathName);
 
@@ -509,10 +637,10 @@ bool deleteEntry(const uint8_t partIdx, const uint32_t baseDir, const char* cons
                     }
                 }
             }
-
-            mem_free(dirsec);
         }
     }
+
+    mem_free(dirsec);
 	
 	if (!entryFound)
 	{
@@ -535,7 +663,7 @@ bool deleteEntry(const uint8_t partIdx, const uint32_t baseDir, const char* cons
     uint32_t* entrycc = getClusterChain(partIdx, entryCluster);
 
     // Free each one of the clusters used by the entry
-	for (size_t i = 0; entrycc[i] < CLUSTER_CHAIN_TERMINATOR && !endOfDir && !entryFound; i++)
+	for (size_t i = 0; entrycc[i] < CLUSTER_CHAIN_TERMINATOR; i++)
     {
 		// Free the cluster
 		fatWrite(partIdx, entrycc[i], 0);
@@ -543,7 +671,7 @@ bool deleteEntry(const uint8_t partIdx, const uint32_t baseDir, const char* cons
 
     mem_free(entrycc);
     
-    return true;
+    return fatFlush(partIdx);
 }
 
 struct FILE* writeFile(const uint8_t partIdx, const uint32_t baseDir, const char* const path, const uint8_t* const data, const size_t dataSize)
@@ -591,6 +719,8 @@ struct FILE* writeFile(const uint8_t partIdx, const uint32_t baseDir, const char
         bool endOfDir = false;
         bool entryFound = false;
 
+        struct DIR_SECTOR* dirsec = (struct DIR_SECTOR*)mem_dynalloc(sizeof(struct DIR_SECTOR));
+
         // Search through the cluster chain until the end of the directory is reached or the entry is found
         for (size_t ccIdx = 0; dircc[ccIdx] < CLUSTER_CHAIN_TERMINATOR && !endOfDir && !entryFound; ccIdx++)
         {
@@ -601,7 +731,18 @@ struct FILE* writeFile(const uint8_t partIdx, const uint32_t baseDir, const char
             for (size_t secIdx = 0; secIdx < partArray[partIdx].sectorsPerCluster && !endOfDir && !entryFound; secIdx++)
             {
                 // Read the sector from the drive
-                struct DIR_SECTOR* dirsec = (struct DIR_SECTOR*)hddRead(partArray[partIdx].hddIdx, dirClusterBase + secIdx);
+                // The buffer would still hold the previous sector, writing it back would overwrite this one
+                if (!hddReadInto(partArray[partIdx].hddIdx, dirClusterBase + secIdx, 1, (uint8_t*)dirsec))
+                {
+                    debug_print("fat_entry.c | writeFile() | Unable to read a directory sector!");
+
+                    mem_free(dirsec);
+                    mem_free(dircc);
+                    mem_free(pathName);
+                    mem_free(existingEntry);
+
+                    return (struct FILE*)0;
+                }
 
                 // Look through all the entries in the sector
                 for (size_t entryIdx = 0; entryIdx < 0x10 && !endOfDir && !entryFound; entryIdx++)
@@ -619,11 +760,8 @@ struct FILE* writeFile(const uint8_t partIdx, const uint32_t baseDir, const char
                         dirsec->entries[entryIdx].clusterHigh == existingEntry->clusterHigh && // compare this entry with the entry we're looking for
                         dirsec->entries[entryIdx].clusterLow == existingEntry->clusterLow)
                     {
-                        char* strName = fileNameToString(dirsec->entries[entryIdx].fileName);
-                        bool match = strcmp(strName, pathName);
-                        mem_free(strName);
-
-                        if (!match)
+                        // The entry found earlier has the same name
+                        if (!fileNameEqual(dirsec->entries[entryIdx].fileName, existingEntry->fileName))
                         {
                             continue;
                         }
@@ -645,9 +783,17 @@ struct FILE* writeFile(const uint8_t partIdx, const uint32_t baseDir, const char
                         uint32_t fileFirstCluster = joinCluster(existingEntry->clusterHigh, existingEntry->clusterLow);
 
                         // The cluster chain must be prolonged
-                        if (clustCountNew > clustCountOld)
+                        // The directory entry mustn't claim more data than the cluster chain can hold
+                        if (clustCountNew > clustCountOld && !prolongClusterChain(partIdx, fileFirstCluster, clustCountNew - clustCountOld))
                         {
-                            prolongClusterChain(partIdx, fileFirstCluster, clustCountNew - clustCountOld);
+                            term_writeline("Not enough free space!", false);
+
+                            mem_free(dirsec);
+                            mem_free(dircc);
+                            mem_free(pathName);
+                            mem_free(existingEntry);
+
+                            return (struct FILE*)0;
                         }
                         // The cluster chain must be shortened
                         else if (clustCountNew < clustCountOld)
@@ -661,6 +807,9 @@ struct FILE* writeFile(const uint8_t partIdx, const uint32_t baseDir, const char
                         // Write the updated directory sector to the disk
                         hddWrite(partArray[partIdx].hddIdx, dirClusterBase + secIdx, (uint8_t*)dirsec);
 
+                        // The cached entry holds the old file size
+                        dcacheInvalidate(partIdx, targetDir, existingEntry->fileName);
+
                         // Generate the FILE structure with the updated size
                         file = generateFileStruct(partIdx, existingEntry);
 
@@ -669,11 +818,10 @@ struct FILE* writeFile(const uint8_t partIdx, const uint32_t baseDir, const char
                         entryFound = true;
                     }
                 }
-
-                mem_free(dirsec);
             }
         }
 
+        mem_free(dirsec);
         mem_free(dircc);
         mem_free(pathName);
 
@@ -709,9 +857,9 @@ struct FILE* writeFile(const uint8_t partIdx, const uint32_t baseDir, const char
     }
 
     // Write the data
-    uint32_t* clusterChain = getClusterChain(partIdx, file->cluster);
+    struct CLUSTER_EXTENT* extents = getClusterExtents(partIdx, file->cluster);
 
-    if (!clusterChain)
+    if (!extents)
     {
         debug_print("fat_entry.c | writeFile() | The cluster chain of the file is broken!");
         mem_free(file);
@@ -720,23 +868,41 @@ struct FILE* writeFile(const uint8_t partIdx, const uint32_t baseDir, const char
 
     size_t dataIdx = 0;
 
-    // Write all the clusters
-    for (size_t chainIdx = 0; clusterChain[chainIdx] < CLUSTER_CHAIN_TERMINATOR && dataIdx < dataSize; chainIdx++)
+    // Write all the clusters, each extent of consecutive clusters is written at once
+    for (size_t i = 0; extents[i].length && dataIdx < dataSize; i++)
     {
-        // Get the first sector of the cluster
-        uint64_t clusterBase = clusterToSector(partIdx, clusterChain[chainIdx]);
+        // Get the first sector of the extent
+        uint64_t clusterBase = clusterToSector(partIdx, extents[i].start);
+        size_t runSectors = extents[i].length * partArray[partIdx].sectorsPerCluster;
+
+        // Sectors that are fully covered by the data are written straight from the data buffer
+        size_t fullSectors = (dataSize - dataIdx) >> 9;
+        if (fullSectors > runSectors)
+        {
+            fullSectors = runSectors;
+        }
+
+        if (fullSectors)
+        {
+            hddWriteFrom(partArray[partIdx].hddIdx, clusterBase, fullSectors, &data[dataIdx]);
+            dataIdx += fullSectors << 9;
+        }
 
-        // Write all the sectors in a cluster
-        for (size_t iSec = 0; iSec < partArray[partIdx].sectorsPerCluster && dataIdx < dataSize; iSec++)
+        // The last sector is only partially covered by the data, the rest of it is filled with zeros
+        if (fullSectors < runSectors && dataIdx < dataSize)
         {
-            // Write the data to the disk
-            hddWrite(partArray[partIdx].hddIdx, clusterBase + iSec, &data[dataIdx]);
+            uint8_t* lastsec = mem_dynalloc(0x200);
+            mem_copy(&data[dataIdx], lastsec, dataSize - dataIdx);
+            mem_set(&lastsec[dataSize - dataIdx], 0, 0x200 - (dataSize - dataIdx));
+
+            hddWriteFrom(partArray[partIdx].hddIdx, clusterBase + fullSectors, 1, lastsec);
+            dataIdx = dataSize;
 
-            dataIdx += 0x200;
+            mem_free(lastsec);
         }
     }
 
-    mem_free(clusterChain);
+    mem_free(extents);
 
     debug_print("fat_entry.c | writeFile() | File has been written successfully!");
 
@@ -781,6 +947,24 @@ bool renameEntry(const uint8_t partIdx, const uint32_t baseDir, const char* cons
 		return false;
 	}
 
+    // Both names are converted only once, entries are then compared in the format they're stored in
+    char fileName[11];
+    char newFileName[11];
+
+    if (!stringToFileName(newName, newFileName))
+    {
+        mem_free(pathName);
+        term_writeline("Invalid new name!", false);
+        return false;
+    }
+
+    if (!stringToFileName(pathName, fileName))
+    {
+        mem_free(pathName);
+        term_writeline("Specified entry doesn't exist!", false);
+        return false;
+    }
+
     // Make sure the new name doesn't conflict with an existing file
     struct DIR_ENTRY* existingEntry = findEntry(partIdx, targetDir, newName, 0, 0);
 
@@ -799,6 +983,8 @@ bool renameEntry(const uint8_t partIdx, const uint32_t baseDir, const char* cons
 
     bool endOfDir = false;
 
+    struct DIR_SECTOR* dirsec = (struct DIR_SECTOR*)mem_dynalloc(sizeof(struct DIR_SECTOR));
+
     // Search through the cluster chain until the end of the directory is reached
     for (size_t chainIdx = 0; clusterChain[chainIdx] < CLUSTER_CHAIN_TERMINATOR && !endOfDir; chainIdx++)
     {
@@ -809,7 +995,17 @@ bool renameEntry(const uint8_t partIdx, const uint32_t baseDir, const char* cons
         for (size_t iSec = 0; iSec < partArray[partIdx].sectorsPerCluster && !endOfDir; iSec++)
         {
             // Read the sector from the drive
-            struct DIR_SECTOR* dirsec = (struct DIR_SECTOR*)hddRead(partArray[partIdx].hddIdx, clusterBase + iSec);
+            // The buffer would still hold the previous sector, writing it back would overwrite this one
+            if (!hddReadInto(partArray[partIdx].hddIdx, clusterBase + iSec, 1, (uint8_t*)dirsec))
+            {
+                debug_print("fat_entry.c | renameEntry() | Unable to read a directory sector!");
+
+                mem_free(dirsec);
+                mem_free(clusterChain);
+                mem_free(pathName);
+
+                return false;
+            }
 
             // Look through all the entries in the sector
             for (size_t iEntry = 0; iEntry < 0x10 && !endOfDir; iEntry++)
@@ -826,19 +1022,17 @@ bool renameEntry(const uint8_t partIdx, const uint32_t baseDir, const char* cons
                 else if (entryFirstByte != DIR_ENTRY_UNUSED && // mustn't be an unused entry
                     dirsec->entries[iEntry].attrib != FILE_ATTRIB_LONG_NAME) // mustn't be a long name entry
                 {
-                    char* strName = fileNameToString(dirsec->entries[iEntry].fileName);
-                    bool namesMatch = strcmp(pathName, strName);
-                    mem_free(strName);
-
                     // Names match, rename the entry
-                    if (namesMatch)
+                    if (fileNameEqual(dirsec->entries[iEntry].fileName, fileName))
                     {
-                        // Generate file name from the string
-                        stringToFileName(newName, dirsec->entries[iEntry].fileName);
+                        mem_copy(newFileName, dirsec->entries[iEntry].fileName, sizeof(newFileName));
 
                         // Write the updated directory sector to the disk
                         hddWrite(partArray[partIdx].hddIdx, clusterBase + iSec, (uint8_t*)dirsec);
 
+                        dcacheInvalidate(partIdx, targetDir, fileName);
+                        dcacheInvalidate(partIdx, targetDir, newFileName);
+
                         mem_free(dirsec);
                         mem_free(clusterChain);
                         mem_free(pathName);
@@ -849,10 +1043,10 @@ bool renameEntry(const uint8_t partIdx, const uint32_t baseDir, const char* cons
                 }
             }
 
-            mem_free(dirsec);
         }
     }
 
+    mem_free(dirsec);
     mem_free(clusterChain);
     mem_free(pathName);
 
@@ -11,6 +11,13 @@ bool hdd_init(const uint8_t hddIdx)
     bool isValidFat = false;
     struct MBR* mbr = (struct MBR*)hddRead(hddIdx, 0);
 
+    // The drive didn't respond, it can't be used
+    if (!mbr)
+    {
+        term_writeline("FAT Error: Unable to read the Master Boot Record!", false);
+        return false;
+    }
+
     // Check the boot segment signature 0xAA55
     if (mbr->signature == FAT_SIGNATURE)
     {
@@ -27,12 +34,21 @@ bool hdd_init(const uint8_t hddIdx)
                 
                 if (partValid[i])
                 {
-                    isValidFat = true;
-
-                    partArray[partCount - 1].lbaBegin = mbr->part[i].lbabegin;
+                    partArray[partCount - 1].hddIdx = hddIdx;
                     partArray[partCount - 1].lbaBegin = mbr->part[i].lbabegin;
                     partArray[partCount - 1].sectorCount = mbr->part[i].sectors;
 
+                    // The partition can't be used without its FAT
+                    if (!fatLoad(partCount - 1))
+                    {
+                        term_writeline("FAT Error: Unable to load the FAT!", false);
+                        partValid[i] = false;
+                        partCount--;
+                        continue;
+                    }
+
+                    isValidFat = true;
+
                     term_writeline(getPartInfoStr(partCount - 1), true);
                 }
             }
@@ -13,6 +13,13 @@ bool checkVolumeID(const uint8_t hddIdx, const uint64_t lba)
 {
     struct VOLUMEID* volid = (struct VOLUMEID*)hddRead(hddIdx, lba);
 
+    // A partition whose Volume ID can't be read is treated as invalid
+    if (!volid)
+    {
+        debug_print("fat_part.c | checkVolumeID() | Unable to read the Volume ID!");
+        return false;
+    }
+
     bool volumeidValid =
         (volid->bytesPerSector == BYTES_PER_SECTOR) &&
         (volid->fatCount == FAT_COUNT) &&
@@ -25,6 +32,7 @@ bool checkVolumeID(const uint8_t hddIdx, const uint64_t lba)
         partArray[partCount].reservedSectors = volid->reservedSectors;
         partArray[partCount].fatSectors = volid->fatSectors;
         partArray[partCount].rootDirCluster = volid->rootDirCluster;
+        partArray[partCount].fsInfoSector = volid->fsInfoSector;
         partArray[partCount].extBootSignature = volid->extBootSignature;
         partArray[partCount].volumeID = volid->volumeID;
 
@@ -53,6 +61,39 @@ bool checkVolumeID(const uint8_t hddIdx, const uint64_t lba)
     return volumeidValid;
 }
 
+// Appends a number of bytes with digits separated into groups of 3 to the partition info string
+// tostr() only handles 32-bit numbers, so sizes of 4 GiB and more are appended in KiB instead
+static void appendBytes(char* const strInfo, size_t* const strIdx, const uint64_t bytes)
+{
+    const bool kib = (bytes >> 32) != 0;
+    char* strbytes = tostr((size_t)(kib ? bytes >> 10 : bytes), 10);
+    size_t byteslen = strlen(strbytes);
+
+    for (size_t i = 0; i < byteslen; i++)
+    {
+        // Separate each 3 digits by ','
+        if (i > 0 && (byteslen - i) % 3 == 0)
+        {
+            strInfo[(*strIdx)++] = ',';
+        }
+
+        strInfo[(*strIdx)++] = strbytes[i];
+    }
+
+    mem_free(strbytes);
+
+    if (kib)
+    {
+        strcopy(" KiB", &strInfo[*strIdx]);
+        *strIdx += 4;
+    }
+    else
+    {
+        strcopy(" Bytes", &strInfo[*strIdx]);
+        *strIdx += 6;
+    }
+}
+
 char* getPartInfoStr(const uint8_t partIdx)
 {
     // Generate the partition info string
@@ -145,33 +186,21 @@ char* getPartInfoStr(const uint8_t partIdx)
         }
     }
 
-    // Size of the partition in Bytes
-    char* strbytes = tostr(partArray[partIdx].sectorCount * BYTES_PER_SECTOR, 10);
-    size_t byteslen = strlen(strbytes);
-
     strInfo[strIdx++] = ' ';
     strInfo[strIdx++] = ':';
     strInfo[strIdx++] = ' ';
 
-    for (size_t i = 0; i < byteslen; i++)
-    {
-        // Separate each 3 digits by ','
-        if (i > 0 && (byteslen - i) % 3 == 0)
-        {
-            strInfo[strIdx++] = ',';
-        }
+    // Size of the partition in Bytes
+    appendBytes(strInfo, &strIdx, (uint64_t)partArray[partIdx].sectorCount * BYTES_PER_SECTOR);
 
-        strInfo[strIdx++] = strbytes[i];
-    }
+    strInfo[strIdx++] = ' ';
+    strInfo[strIdx++] = '(';
 
-    mem_free(strbytes);
+    // Free space on the partition, the free cluster count is kept up to date, so nothing has to be scanned
+    appendBytes(strInfo, &strIdx, (uint64_t)partArray[partIdx].freeClusters * partArray[partIdx].sectorsPerCluster * BYTES_PER_SECTOR);
 
-    strInfo[strIdx++] = ' ';
-    strInfo[strIdx++] = 'B';
-    strInfo[strIdx++] = 'y';
-    strInfo[strIdx++] = 't';
-    strInfo[strIdx++] = 'e';
-    strInfo[strIdx++] = 's';
+    strcopy(" free)", &strInfo[strIdx]);
+    strIdx += 6;
 
     strInfo[strIdx] = '\0';
 
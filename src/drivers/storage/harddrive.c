@@ -1,6 +1,8 @@
 #include <drivers/storage/harddrive.h>
 #include <drivers/storage/atapio.h>
+#include <drivers/storage/idedma.h>
 #include <drivers/storage/ahci.h>
+#include <drivers/storage/cache.h>
 #include <drivers/memory.h>
 #include <drivers/storage/fat.h>
 #include <c/string.h>
@@ -74,41 +76,84 @@ void hddAddAHCI(const HBA_PORT* const port)
 }
 
 uint8_t* hddRead(const uint8_t hddIdx, const uint64_t lba)
+{
+    // The buffer must be suitable for DMA in case the controller writes into it directly
+    uint8_t* buff = (uint8_t*)mem_dmaalloc(0x200, 0);
+
+    if (!hddReadInto(hddIdx, lba, 1, buff))
+    {
+        mem_free(buff);
+        return (uint8_t*)0;
+    }
+
+    return buff;
+}
+
+bool hddReadInto(const uint8_t hddIdx, const uint64_t lba, const size_t count, uint8_t* const buffer)
+{
+    return cache_read(hddIdx, lba, count, buffer);
+}
+
+bool hddReadDirect(const uint8_t hddIdx, const uint64_t lba, const size_t count, uint8_t* const buffer)
 {
     struct HARDDRIVE* hdd = &hddArray[hddIdx];
 
     if (hdd->type == HDD_TYPE_IDE)
     {
-        return readLBA48((uint16_t)(hdd->addr >> 8), (uint8_t)hdd->addr, lba);
+        uint16_t bus = (uint16_t)(hdd->addr >> 8);
+
+        // Fall back to PIO if DMA can't be used with this buffer or the transfer failed
+        if (idedma_read(bus, (uint8_t)hdd->addr, lba, count, buffer))
+        {
+            return true;
+        }
+
+        return readLBA48Into(bus, (uint8_t)hdd->addr, lba, count, buffer);
     }
     else if (hdd->type == HDD_TYPE_AHCI)
     {
-        uint8_t* buff = (uint8_t*)mem_dynalloc(0x200);
-        ahci_read((HBA_PORT*)hdd->addr, lba, 1, (uint16_t*)buff);
-        return buff;
+        // The controller writes the sectors straight into the buffer
+        return ahci_read((HBA_PORT*)hdd->addr, lba, count, (uint16_t*)buffer);
     }
     else
     {
-        debug_print("harddrive.c | hddRead() | Invalid disk type!");
-        return (uint8_t*)0;
+        debug_print("harddrive.c | hddReadDirect() | Invalid disk type!");
+        return false;
     }
 }
 
 void hddWrite(const uint8_t hddIdx, const uint64_t lba, const uint8_t* const data)
+{
+    hddWriteFrom(hddIdx, lba, 1, data);
+}
+
+bool hddWriteFrom(const uint8_t hddIdx, const uint64_t lba, const size_t count, const uint8_t* const buffer)
+{
+    return cache_write(hddIdx, lba, count, buffer);
+}
+
+bool hddWriteDirect(const uint8_t hddIdx, const uint64_t lba, const size_t count, const uint8_t* const buffer)
 {
     struct HARDDRIVE* hdd = &hddArray[hddIdx];
 
     if (hdd->type == HDD_TYPE_IDE)
     {
-        writeLBA48((uint16_t)(hdd->addr >> 8), (uint8_t)hdd->addr, lba, data);
+        uint16_t bus = (uint16_t)(hdd->addr >> 8);
+
+        if (idedma_write(bus, (uint8_t)hdd->addr, lba, count, buffer))
+        {
+            return true;
+        }
+
+        return writeLBA48From(bus, (uint8_t)hdd->addr, lba, count, buffer);
     }
     else if (hdd->type == HDD_TYPE_AHCI)
     {
-        debug_print("harddrive.c | hddWrite() | Writing to an AHCI device is not yet implemented!");
-        // TODO
+        return ahci_write((HBA_PORT*)hdd->addr, lba, count, (const uint16_t*)buffer);
     }
     else
     {
-        debug_print("harddrive.c | hddWrite() | Invalid disk type!");
+        debug_print("harddrive.c | hddWriteDirect() | Invalid disk type!");
+        return false;
     }
 }
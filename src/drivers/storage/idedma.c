@@ -0,0 +1,224 @@
+#include <drivers/storage/idedma.h>
+#include <drivers/pci.h>
+#include <drivers/memory.h>
+#include <drivers/timer.h>
+#include <assembly.h>
+#include <kernel.h>
+
+// Bus master register offsets, the secondary channel's registers follow the primary channel's
+static const uint16_t BM_REGISTER_COMMAND = 0x0;
+static const uint16_t BM_REGISTER_STATUS  = 0x2;
+static const uint16_t BM_REGISTER_PRDT    = 0x4;
+static const uint16_t BM_CHANNEL_SECONDARY = 0x8;
+
+static const uint8_t BM_COMMAND_START = 0x01;
+static const uint8_t BM_COMMAND_READ  = 0x08; // the controller writes into memory
+
+static const uint8_t BM_STATUS_ACTIVE    = 0x01;
+static const uint8_t BM_STATUS_ERROR     = 0x02;
+static const uint8_t BM_STATUS_INTERRUPT = 0x04;
+
+// ATA command register offset and the DMA commands
+static const uint16_t ATA_REGISTER_COMMAND = 0x7;
+static const uint8_t COMMAND_READ_DMA_EXTENDED  = 0x25;
+static const uint8_t COMMAND_WRITE_DMA_EXTENDED = 0x35;
+
+// ATA status bits checked once a transfer is done, the status register shares its offset with the command register
+static const uint8_t DMA_STATUS_BUSY  = 0x80;
+static const uint8_t DMA_STATUS_FAULT = 0x21; // write fault or error
+
+// The programming interface bit that tells the IDE controller is capable of bus mastering
+static const uint8_t IDE_PROGIF_BUS_MASTER = 0x80;
+
+// A single PRD entry can describe at most 64 KiB and it mustn't cross a 64 KiB boundary
+#define IDEDMA_PRD_LIMIT 0x10000
+// Number of PRD entries in each channel's table
+#define IDEDMA_PRD_COUNT 0x20
+// Maximum number of sectors transferred by a single command, the buffer can then span at most 17 PRD entries
+#define IDEDMA_SECTORS_MAX 0x800
+
+// Physical Region Descriptor, describes a single physically contiguous part of a buffer
+struct IDEDMA_PRD
+{
+    uint32_t addr;  // physical address of the memory region
+    uint16_t size;  // size of the memory region in bytes, 0 means 64 KiB
+    uint16_t flags; // bit 15 marks the last entry of the table
+} __attribute__((packed));
+
+#define IDEDMA_PRD_END 0x8000
+
+// I/O base of the bus master registers, 0 if no bus-master controller was found
+static uint16_t idedmaBase = 0;
+// PRD tables of the primary and the secondary channel
+static struct IDEDMA_PRD* idedmaPrdt[2];
+// Set once a transfer on the channel fails, all the following transfers use PIO instead
+static bool idedmaFailed[2];
+
+void idedma_init(void)
+{
+    uint8_t bus = 0, slot = 0, func = 0;
+
+    if (!findPciDevice(PCI_CLASS_MASS_STORAGE, PCI_SUBCLASS_IDE, &bus, &slot, &func))
+    {
+        debug_print("idedma.c | idedma_init() | No IDE controller found!");
+        return;
+    }
+
+    if (!((pciConfigRead(bus, slot, func, 0x08) >> 8) & IDE_PROGIF_BUS_MASTER))
+    {
+        debug_print("idedma.c | idedma_init() | The IDE controller isn't capable of bus mastering!");
+        return;
+    }
+
+    // BAR4 holds the I/O base of the bus master registers
+    uint32_t bar4 = pciConfigRead(bus, slot, func, 0x20);
+
+    if (!(bar4 & 0x1) || !(bar4 & 0xFFFC))
+    {
+        debug_print("idedma.c | idedma_init() | The bus master registers aren't mapped!");
+        return;
+    }
+
+    pciEnableBusMaster(bus, slot, func);
+
+    // PRD tables must be 4 byte aligned and they mustn't cross a 64 KiB boundary
+    for (size_t i = 0; i < 2; i++)
+    {
+        idedmaPrdt[i] = (struct IDEDMA_PRD*)mem_dmaalloc(IDEDMA_PRD_COUNT * sizeof(struct IDEDMA_PRD), IDEDMA_PRD_LIMIT);
+    }
+
+    idedmaBase = (uint16_t)(bar4 & 0xFFFC);
+}
+
+bool idedma_available(const enum BUS bus)
+{
+    return idedmaBase && (bus == BUS_PRIMARY || bus == BUS_SECONDARY) && !idedmaFailed[bus == BUS_SECONDARY];
+}
+
+// The drive may still be busy with the DMA command, so it must be reset before PIO can be used
+void _idedmafail(const enum BUS bus)
+{
+    idedmaFailed[bus == BUS_SECONDARY] = true;
+    resetBus(bus);
+}
+
+// Fills the channel's PRD table with the memory regions of the buffer
+void _idedmaprdt(struct IDEDMA_PRD* const prdt, const uint8_t* const buffer, const size_t length)
+{
+    size_t addr = mem_physaddr(buffer);
+    size_t end = addr + length;
+    size_t entry = 0;
+
+    while (addr < end)
+    {
+        // Each region ends at the next 64 KiB boundary or at the end of the buffer
+        size_t next = (addr & ~(size_t)(IDEDMA_PRD_LIMIT - 1)) + IDEDMA_PRD_LIMIT;
+        if (next > end)
+        {
+            next = end;
+        }
+
+        prdt[entry].addr = (uint32_t)addr;
+        prdt[entry].size = (uint16_t)(next - addr); // 64 KiB overflows to 0, which is what the controller expects
+        prdt[entry].flags = 0;
+
+        addr = next;
+        entry++;
+    }
+
+    prdt[entry - 1].flags = IDEDMA_PRD_END;
+}
+
+// Transfers up to IDEDMA_SECTORS_MAX sectors with a single command
+bool _idedmatransfer(const enum BUS bus, const enum DRIVE drive, const uint64_t addr, const size_t count, uint8_t* const buffer, const bool write)
+{
+    size_t channel = (bus == BUS_SECONDARY);
+    uint16_t base = idedmaBase + (channel ? BM_CHANNEL_SECONDARY : 0);
+
+    _idedmaprdt(idedmaPrdt[channel], buffer, count << 9);
+
+    // Stop any previous transfer, point the controller to the PRD table and set the direction
+    outb(base + BM_REGISTER_COMMAND, 0);
+    outl(base + BM_REGISTER_PRDT, (uint32_t)mem_physaddr(idedmaPrdt[channel]));
+    outb(base + BM_REGISTER_COMMAND, write ? 0 : BM_COMMAND_READ);
+
+    // The error and interrupt bits are cleared by writing 1 into them
+    outb(base + BM_REGISTER_STATUS, inb(base + BM_REGISTER_STATUS) | BM_STATUS_ERROR | BM_STATUS_INTERRUPT);
+
+    setupLBA48(bus, drive, addr, count);
+    outb(bus + ATA_REGISTER_COMMAND, write ? COMMAND_WRITE_DMA_EXTENDED : COMMAND_READ_DMA_EXTENDED);
+
+    // Start the transfer, the controller moves the data on its own and the CPU sleeps until the drive's interrupt
+    outb(base + BM_REGISTER_COMMAND, (write ? 0 : BM_COMMAND_READ) | BM_COMMAND_START);
+
+    uint64_t deadline = timer_ms() + ATA_TIMEOUT_MS;
+    uint8_t status = 0;
+    bool timeout = false;
+
+    while (!((status = inb(base + BM_REGISTER_STATUS)) & (BM_STATUS_INTERRUPT | BM_STATUS_ERROR)) && (status & BM_STATUS_ACTIVE))
+    {
+        if (timer_ms() >= deadline)
+        {
+            timeout = true;
+            break;
+        }
+
+        ataWait(bus);
+    }
+
+    outb(base + BM_REGISTER_COMMAND, write ? 0 : BM_COMMAND_READ);
+
+    if (timeout)
+    {
+        debug_print("idedma.c | _idedmatransfer() | The transfer timed out!");
+        _idedmafail(bus);
+        return false;
+    }
+
+    // Reading the ATA status register acknowledges the drive's interrupt
+    bool idle = awaitStatusFalse(bus, DMA_STATUS_BUSY);
+    uint8_t ataStatus = inb(bus + ATA_REGISTER_COMMAND);
+
+    outb(base + BM_REGISTER_STATUS, status | BM_STATUS_ERROR | BM_STATUS_INTERRUPT);
+
+    if (!idle || (status & BM_STATUS_ERROR) || (ataStatus & DMA_STATUS_FAULT))
+    {
+        debug_print("idedma.c | _idedmatransfer() | The transfer failed!");
+        _idedmafail(bus);
+        return false;
+    }
+
+    return true;
+}
+
+bool _idedma(const enum BUS bus, const enum DRIVE drive, const uint64_t addr, const size_t count, uint8_t* const buffer, const bool write)
+{
+    // PRD regions must begin at an even address
+    if (!idedma_available(bus) || (mem_physaddr(buffer) & 0x1))
+    {
+        return false;
+    }
+
+    for (size_t done = 0; done < count; done += IDEDMA_SECTORS_MAX)
+    {
+        size_t chunk = (count - done < IDEDMA_SECTORS_MAX ? count - done : IDEDMA_SECTORS_MAX);
+
+        if (!_idedmatransfer(bus, drive, addr + done, chunk, &buffer[done << 9], write))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool idedma_read(const enum BUS bus, const enum DRIVE drive, const uint64_t addr, const size_t count, uint8_t* const buffer)
+{
+    return _idedma(bus, drive, addr, count, buffer, false);
+}
+
+bool idedma_write(const enum BUS bus, const enum DRIVE drive, const uint64_t addr, const size_t count, const uint8_t* const buffer)
+{
+    // The buffer is only read from when writing
+    return _idedma(bus, drive, addr, count, (uint8_t*)buffer, true);
+}
@@ -0,0 +1,58 @@
+#include <drivers/timer.h>
+#include <assembly.h>
+
+#define PIT_CHANNEL_0 0x40
+#define PIT_COMMAND 0x43
+
+// PIT input clock frequency in Hz
+#define PIT_FREQUENCY 1193182
+#define PIT_DIVISOR (PIT_FREQUENCY / TIMER_FREQUENCY)
+
+// The frequency divides 1000, so that converting ticks to milliseconds doesn't need a 64-bit division
+#define TIMER_MS_PER_TICK (1000 / TIMER_FREQUENCY)
+
+// Channel 0, low byte followed by high byte, mode 2 (rate generator)
+#define PIT_MODE_RATE 0x34
+// Channel 0, latch the current count
+#define PIT_LATCH 0x00
+
+// Number of timer ticks since the timer has been initialized
+static volatile uint64_t timerTicks = 0;
+// Last count read from the PIT while interrupts were disabled
+static uint16_t timerLastCount = 0;
+
+void timer_init(void)
+{
+    outb(PIT_COMMAND, PIT_MODE_RATE);
+    outb(PIT_CHANNEL_0, (uint8_t)PIT_DIVISOR);
+    outb(PIT_CHANNEL_0, (uint8_t)(PIT_DIVISOR >> 8));
+}
+
+void timer_handler(void)
+{
+    timerTicks++;
+
+    // Enable interrupts again
+    outb(0x20, 0x20);
+}
+
+uint64_t timer_ms(void)
+{
+    if (!interrupts_enabled())
+    {
+        // The interrupt handler can't count the ticks, so the PIT's counter is polled instead
+        // It counts down from the divisor, a count higher than the previous one means a tick has passed
+        outb(PIT_COMMAND, PIT_LATCH);
+        uint16_t count = inb(PIT_CHANNEL_0);
+        count |= ((uint16_t)inb(PIT_CHANNEL_0)) << 8;
+
+        if (count > timerLastCount)
+        {
+            timerTicks++;
+        }
+
+        timerLastCount = count;
+    }
+
+    return timerTicks * TIMER_MS_PER_TICK;
+}
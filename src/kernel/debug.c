@@ -34,6 +34,26 @@ void debug_print(const char* const str)
     #pragma GCC diagnostic pop
 #endif
 
+#ifndef DEBUG
+    #pragma GCC diagnostic push
+    #pragma GCC diagnostic ignored "-Wunused-parameter"
+#endif
+void debug_cycles(const char* const str, const uint64_t cycles)
+{
+    #ifdef DEBUG
+
+    term_write("DEBUG: ", false);
+    term_write(str, false);
+    term_write(" took ", false);
+    term_write_convert((size_t)(cycles >> 10), 10);
+    term_writeline(" Ki cycles", false);
+
+    #endif
+}
+#ifndef DEBUG
+    #pragma GCC diagnostic pop
+#endif
+
 void debug_pause(void)
 {
     #ifdef DEBUG
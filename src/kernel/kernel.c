@@ -7,11 +7,14 @@
 #endif
 
 #include <kernel.h>
+#include <multiboot.h>
+#include <assembly.h>
 
 // These _init() functions are not in their respective headers because
 // they're supposed to be never called from anywhere else than from here
 
 void term_init(void);
+void frame_init(const uint32_t mbmagic, const struct MULTIBOOT_INFO* const mbinfo);
 void mem_init(void);
 void dev_init(void);
 
@@ -19,14 +22,25 @@ void interrupts_init(void);
 void shell_init(void);
 void load_gdt(void);
 
-void kernel_main(void)
+void kernel_main(const uint32_t mbmagic, const struct MULTIBOOT_INFO* const mbinfo)
 {
+	// Boot time is measured from here to the start of the Shell in DEBUG mode
+	uint64_t boottime = rdtsc();
+
 	// Initialize basic components
     load_gdt(); 		// Global Descriptor Table
 	term_init(); 		// Terminal
+	frame_init(mbmagic, mbinfo); // Physical Memory
+
+	uint64_t memtime = rdtsc();
 	mem_init(); 		// Memory Management
-	dev_init(); 		// Devices
+	debug_cycles("Memory initialization", rdtsc() - memtime);
+
+	// Interrupts must be initialized first, disk drivers wait for their interrupts and use the timer
 	interrupts_init(); 	// Interrupts
+	dev_init(); 		// Devices
+
+	debug_cycles("Boot", rdtsc() - boottime);
 
 	// Start the Shell module
 	shell_init();
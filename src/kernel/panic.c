@@ -1,6 +1,7 @@
 #include <assembly.h>
 #include <drivers/io/terminal.h>
 #include <c/string.h>
+#include <drivers/storage/cache.h>
 
 void strcenter(const char* const strSource, char* const strOutput)
 {
@@ -78,6 +79,14 @@ void kernel_panic(const char* const str)
     static const char strHeader[] = "Kernel Panic\n\n\n\n";
     static char strText[1024];
     static char strFormatted[2048];
+    static bool flushing = false;
+
+    // Try to save the modified sectors, unless the panic comes from the flush itself
+    if (!flushing)
+    {
+        flushing = true;
+        cache_flush();
+    }
 
     size_t textIdx = 0;
 
@@ -0,0 +1,188 @@
+#include <c/stdio.h>
+#include <c/stdlib.h>
+
+#include <cpp/string.hpp>
+#include <cpp/vector.hpp>
+
+#include <drivers/memory.h>
+#include <drivers/storage/harddrive.h>
+#include <assembly.h>
+
+// Each memory benchmark processes BENCH_MEMORY_SIZE bytes BENCH_MEMORY_ROUNDS times
+static const size_t BENCH_MEMORY_SIZE = 0x40000;
+static const size_t BENCH_MEMORY_ROUNDS = 0x10;
+
+// Each disk benchmark reads BENCH_DISK_SECTORS sectors from the beginning of the first disk BENCH_DISK_ROUNDS times
+static const size_t BENCH_DISK_SECTORS = 0x80;
+static const size_t BENCH_DISK_ROUNDS = 0x4;
+
+void cmd_bench_list_arguments(void)
+{
+    print("Valid arguments:\n");
+    print("memory - measures memory copy and fill throughput\n");
+    print("disk - measures sector read throughput of the first disk\n");
+}
+
+// The way mem_copy() used to copy memory, kept for comparison
+void __attribute__((noinline)) cmd_bench_copy_bytes(const uint8_t* const src, uint8_t* const dst, const size_t length)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        dst[i] = src[i];
+    }
+}
+
+// Aligned 32-bit copy written in C
+void __attribute__((noinline)) cmd_bench_copy_words(const uint32_t* const src, uint32_t* const dst, const size_t length)
+{
+    for (size_t i = 0; i < length / sizeof(uint32_t); i++)
+    {
+        dst[i] = src[i];
+    }
+}
+
+// The way mem_set() used to fill memory, kept for comparison
+void __attribute__((noinline)) cmd_bench_set_bytes(uint8_t* const dst, const uint8_t value, const size_t length)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        dst[i] = value;
+    }
+}
+
+// Prints the average number of CPU cycles it took to process a KiB of memory
+void cmd_bench_print(const char* const name, const uint64_t cycles)
+{
+    print(name);
+    print(": ");
+    printint((size_t)(cycles / ((BENCH_MEMORY_SIZE >> 10) * BENCH_MEMORY_ROUNDS)));
+    print(" cycles / KiB\n");
+}
+
+void cmd_bench_memory(void)
+{
+    uint8_t* src = (uint8_t*)malloc(BENCH_MEMORY_SIZE + sizeof(uint32_t));
+    uint8_t* dst = (uint8_t*)malloc(BENCH_MEMORY_SIZE + sizeof(uint32_t));
+
+    // Touch both buffers before measuring anything
+    for (size_t i = 0; i < BENCH_MEMORY_SIZE; i++)
+    {
+        src[i] = (uint8_t)i;
+    }
+
+    mem_copy(src, dst, BENCH_MEMORY_SIZE);
+
+    uint64_t start = rdtsc();
+    for (size_t i = 0; i < BENCH_MEMORY_ROUNDS; i++)
+        cmd_bench_copy_bytes(src, dst, BENCH_MEMORY_SIZE);
+    cmd_bench_print("Byte copy", rdtsc() - start);
+
+    start = rdtsc();
+    for (size_t i = 0; i < BENCH_MEMORY_ROUNDS; i++)
+        cmd_bench_copy_words((const uint32_t*)src, (uint32_t*)dst, BENCH_MEMORY_SIZE);
+    cmd_bench_print("Word copy", rdtsc() - start);
+
+    start = rdtsc();
+    for (size_t i = 0; i < BENCH_MEMORY_ROUNDS; i++)
+        mem_copy(src, dst, BENCH_MEMORY_SIZE);
+    cmd_bench_print("mem_copy (aligned)", rdtsc() - start);
+
+    start = rdtsc();
+    for (size_t i = 0; i < BENCH_MEMORY_ROUNDS; i++)
+        mem_copy(src + 1, dst + 3, BENCH_MEMORY_SIZE);
+    cmd_bench_print("mem_copy (misaligned)", rdtsc() - start);
+
+    start = rdtsc();
+    for (size_t i = 0; i < BENCH_MEMORY_ROUNDS; i++)
+        mem_move(dst, dst + 4, BENCH_MEMORY_SIZE - 4);
+    cmd_bench_print("mem_move (overlapping)", rdtsc() - start);
+
+    start = rdtsc();
+    for (size_t i = 0; i < BENCH_MEMORY_ROUNDS; i++)
+        cmd_bench_set_bytes(dst, (uint8_t)i, BENCH_MEMORY_SIZE);
+    cmd_bench_print("Byte fill", rdtsc() - start);
+
+    start = rdtsc();
+    for (size_t i = 0; i < BENCH_MEMORY_ROUNDS; i++)
+        mem_set(dst, (uint8_t)i, BENCH_MEMORY_SIZE);
+    cmd_bench_print("mem_set", rdtsc() - start);
+
+    delete src;
+    delete dst;
+}
+
+// Prints the average number of CPU cycles it took to read a sector
+void cmd_bench_print_disk(const char* const name, const uint64_t cycles)
+{
+    print(name);
+    print(": ");
+    printint((size_t)(cycles / (BENCH_DISK_SECTORS * BENCH_DISK_ROUNDS)));
+    print(" cycles / sector\n");
+}
+
+void cmd_bench_disk(void)
+{
+    if (!hddCount)
+    {
+        print("No hard disks found.\n");
+        return;
+    }
+
+    // The buffer must be usable by disk controllers that write into memory directly
+    uint8_t* buffer = (uint8_t*)mem_dmaalloc(BENCH_DISK_SECTORS << 9, 0);
+
+    // The block cache is bypassed, so that the disk itself is measured
+    // Read the sectors once before measuring anything, so that the disk is spinning and any of its caches are warm
+    if (!hddReadDirect(0, 0, BENCH_DISK_SECTORS, buffer))
+    {
+        print("Unable to read from the disk!\n");
+        delete buffer;
+        return;
+    }
+
+    uint64_t start = rdtsc();
+    for (size_t i = 0; i < BENCH_DISK_ROUNDS; i++)
+        for (size_t j = 0; j < BENCH_DISK_SECTORS; j++)
+            hddReadDirect(0, j, 1, &buffer[j << 9]);
+    cmd_bench_print_disk("Single-sector reads", rdtsc() - start);
+
+    start = rdtsc();
+    for (size_t i = 0; i < BENCH_DISK_ROUNDS; i++)
+        hddReadDirect(0, 0, BENCH_DISK_SECTORS, buffer);
+    cmd_bench_print_disk("Multi-sector reads", rdtsc() - start);
+
+    delete buffer;
+}
+
+void cmd_bench(const string& strArgs)
+{
+    vector<string> vecArgs = strArgs.split(' ', true);
+
+    if (vecArgs.size() != 1)
+    {
+        print("Invalid arguments!\n");
+        print("Syntax: bench <Argument>\n");
+        cmd_bench_list_arguments();
+
+        vecArgs.dispose();
+        return;
+    }
+
+    if (vecArgs.at(0) == "memory")
+    {
+        cmd_bench_memory();
+    }
+    else if (vecArgs.at(0) == "disk")
+    {
+        cmd_bench_disk();
+    }
+    else
+    {
+        print("Invalid argument: \"");
+        sprint(vecArgs.at(0));
+        print("\"\n");
+        cmd_bench_list_arguments();
+    }
+
+    vecArgs.dispose();
+}
@@ -18,6 +18,7 @@ void cmd_help(const string& strArgs)
 
     print("COMMAND <REQUIRED ARGUMENT> [OPTIONAL ARGUMENT]\n");
     print("<Partition Letter>: - Changes active partition\n");
+    print("bench <Argument> - Measures performance of the system\n");
     print("cd <Directory Path> - Changes active directory\n");
     print("clear - Clears the terminal screen\n");
     print("color <Background Color> <Foreground Color> - Changes color scheme of shell\n");
@@ -27,6 +28,7 @@ void cmd_help(const string& strArgs)
     print("disk <Argument> - Prints disk-related information\n");
     print("exec <File Path> - Executes program file\n");
     print("help - Displays available commands and their syntax\n");
+    print("meminfo - Displays memory usage and allocation statistics\n");
     print("mkdir <Directory Path> - Creates new directory\n");
     print("mkfile <File Path> - Creates new file\n");
     print("move <Source File Path> <Target File Path> - Moves source file to target path\n");
@@ -0,0 +1,158 @@
+#include <c/stdio.h>
+
+#include <cpp/string.hpp>
+#include <cpp/vector.hpp>
+
+#include <drivers/memory.h>
+#include <drivers/memprofile.h>
+#include <drivers/storage/cache.h>
+
+// Number of call sites listed as the top allocators
+static const size_t MEMINFO_TOP_SITES = 8;
+
+// Prints a size in KiB
+void cmd_meminfo_print_kib(const char* const name, const size_t bytes)
+{
+    print(name);
+    print(": ");
+    printint(bytes >> 10);
+    print(" KiB\n");
+}
+
+void cmd_meminfo_print_sites(void)
+{
+    struct MEMPROF_SITE sites[MEMINFO_TOP_SITES];
+    size_t count = memprof_top(sites, MEMINFO_TOP_SITES);
+
+    print("Top allocators (caller: allocations / live objects / live bytes / average size / average lifetime):\n");
+
+    for (size_t i = 0; i < count; i++)
+    {
+        print("0x");
+        printhex((size_t)sites[i].caller);
+        print(": ");
+        printint(sites[i].allocs);
+        print(" / ");
+        printint(sites[i].allocs - sites[i].frees);
+        print(" / ");
+        printint(sites[i].livebytes);
+        print(" B / ");
+        printint(sites[i].totalbytes / sites[i].allocs);
+        print(" B / ");
+
+        // Lifetime is only known once at least one of the objects has been freed
+        if (sites[i].frees)
+        {
+            printint((size_t)(sites[i].lifetime >> 10) / sites[i].frees);
+            print(" Ki cycles");
+        }
+        else
+        {
+            print("-");
+        }
+
+        if (sites[i].resizes)
+        {
+            print(" (");
+            printint(sites[i].resizes);
+            print(" resizes)");
+        }
+
+        newline();
+    }
+
+    if (memprof_untracked())
+    {
+        print("Untracked allocations: ");
+        printint(memprof_untracked());
+        newline();
+    }
+}
+
+void cmd_meminfo_print_histogram(void)
+{
+    size_t buckets[MEMPROF_BUCKET_COUNT];
+    memprof_histogram(buckets);
+
+    print("Allocation sizes (up to: allocations):\n");
+
+    for (size_t i = 0; i < MEMPROF_BUCKET_COUNT; i++)
+    {
+        if (!buckets[i])
+        {
+            continue;
+        }
+
+        // Bucket i holds sizes below 2^i, the last bucket has no upper limit
+        if (i + 1 < MEMPROF_BUCKET_COUNT)
+        {
+            printint((((size_t)1) << i) - 1);
+        }
+        else
+        {
+            print("more");
+        }
+
+        print(" B: ");
+        printint(buckets[i]);
+        newline();
+    }
+}
+
+void cmd_meminfo(const string& strArgs)
+{
+    vector<string> vecArgs = strArgs.split(' ', true);
+
+    if (vecArgs.size() != 0)
+    {
+        print("Invalid arguments!\n");
+        print("Syntax: meminfo\n");
+
+        vecArgs.dispose();
+        return;
+    }
+
+    vecArgs.dispose();
+
+    struct MEM_STATS stats;
+    mem_stats(&stats);
+
+    cmd_meminfo_print_kib("Used memory", stats.used);
+    cmd_meminfo_print_kib("High-water mark", stats.peak);
+    cmd_meminfo_print_kib("Free memory", stats.empty);
+    cmd_meminfo_print_kib("Largest free run", stats.largestfree);
+
+    // Fragmentation is the part of the free memory that isn't in the largest free run
+    print("Fragmentation: ");
+    size_t emptykib = stats.empty >> 10;
+    printint(emptykib ? 100 - ((stats.largestfree >> 10) * 100) / emptykib : 0);
+    print("%\n");
+
+    print("Live allocations: ");
+    printint(stats.segments);
+    print(" (");
+    printint(stats.allocated);
+    print(" B)\n");
+
+    struct CACHE_STATS cache;
+    cache_stats(&cache);
+
+    print("Block cache: ");
+    printint(cache.hits);
+    print(" hits, ");
+    printint(cache.misses);
+    print(" misses, ");
+    printint(cache.dirty);
+    print(" dirty, ");
+    printint(cache.writebacks);
+    print(" written back\n");
+
+    if (!memprof_enabled())
+    {
+        print("Allocation profiling is only available in DEBUG mode.\n");
+        return;
+    }
+
+    cmd_meminfo_print_sites();
+    cmd_meminfo_print_histogram();
+}
@@ -1,5 +1,6 @@
 #include <modules/exec.hpp>
 #include <c/stdio.h>
+#include <drivers/memory.h>
 
 void Program::run(const char* const codePtr)
 {
@@ -29,7 +30,10 @@ void Program::run(const char* const codePtr)
         // Execute commands one after another until the program finishes
         while (m_counter < m_program.size())
         {
+            // Values boxed while evaluating the command are released right after it
+            mem_regionpush();
             Program::executeCommand();
+            mem_regionpop();
         }
 
         // After the program execution is done the scope level should be 0
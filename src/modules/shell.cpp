@@ -8,8 +8,10 @@
 #include <cpp/vector.hpp>
 
 #include <kernel.h>
+#include <drivers/memory.h>
 
 #include <drivers/storage/fat.h>
+#include <drivers/storage/cache.h>
 #include <modules/commands.hpp>
 #include <modules/settings.hpp>
 
@@ -31,6 +33,9 @@ namespace Shell
 
 	void process(const string& strInput)
 	{
+		// Temporary objects allocated from a memory region by the command are released when it ends
+		mem_regionpush();
+
 		// Extract command string from the input string
 		string strCmd;
 
@@ -133,6 +138,14 @@ namespace Shell
 		{
 			cmd_color(strArgs);
 		}
+		else if (strCmd.compare("bench"))
+		{
+			cmd_bench(strArgs);
+		}
+		else if (strCmd.compare("meminfo"))
+		{
+			cmd_meminfo(strArgs);
+		}
 		else
 		{
 			print("Invalid command: \"");
@@ -142,6 +155,11 @@ namespace Shell
 
 		strCmd.dispose();
 		strArgs.dispose();
+
+		// Modified sectors are written to the disk once the command is done
+		cache_flush();
+
+		mem_regionpop();
 	}
 
 	void historyAppend(const string& strInput)